@@ -3,15 +3,24 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the controller is a PCI bus master IDE controller, as
+   QEMU's PIIX is, and a disk supports DMA, sectors are
+   transferred by DMA instead of programmed I/O, so that the CPU
+   does not copy the data itself.  See [SFF-8038i].  A disk whose
+   DMA transfer fails goes back to programmed I/O. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -30,10 +39,16 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -43,12 +58,40 @@
 #define DEV_LBA 0x40            /* Linear based addressing. */
 #define DEV_DEV 0x10            /* Select device: 0=master, 1=slave. */
 
+/* Bus Master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer into memory. */
+
+/* Bus Master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
+#define BM_STA_DMA0 0x20        /* Device 0 is DMA capable. */
+
 /* Commands.
    Many more are defined but this is the small subset that we
    use. */
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where to transfer data.  A region may
+   not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, with 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Most sectors transferred by one command.  Each sector's buffer
+   may need two PRDs if it crosses a 64 kB boundary. */
+#define IDE_MAX_SECTORS 16
+#define PRD_CNT (IDE_MAX_SECTORS * 2)
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +100,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Transfer by DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -66,13 +110,19 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus master I/O base, or 0 if none. */
 
     struct lock lock;           /* Must acquire to access the controller. */
+    struct lock_stats lock_stats;       /* Contention on LOCK. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
+
+    /* PRD table for DMA.  Aligning it to its size keeps it from
+       crossing a 64 kB boundary. */
+    struct prd prdt[PRD_CNT] __attribute__ ((aligned (PRD_CNT * 8)));
   };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
@@ -81,14 +131,20 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void ide_read_multiple (void *, block_sector_t, void *const[], size_t);
+static void ide_write_multiple (void *, block_sector_t, void *const[],
+                                size_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static bool dma_transfer (struct ata_disk *, block_sector_t,
+                          void *const buffers[], size_t cnt, bool write);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -101,6 +157,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -123,7 +180,9 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
+      c->bm_base = bm_base != 0 ? bm_base + 8 * chan_no : 0;
       lock_init (&c->lock);
+      lock_profile (&c->lock, &c->lock_stats, c->name);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -136,6 +195,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -159,6 +219,29 @@ ide_init (void)
 
 static char *descramble_ata_string (char *, int size);
 
+/* Looks for a PCI IDE controller that can act as a bus master,
+   enables bus mastering on it, and returns the base of its bus
+   master registers.  Returns 0 if there is no such controller. */
+static uint16_t
+find_bus_master (void) 
+{
+  struct pci_dev pci;
+  uint32_t bar4, command;
+
+  if (!pci_find_class (0x01, 0x01, &pci))
+    return 0;
+
+  /* The bus master registers are in I/O space, at BAR4. */
+  bar4 = pci_read_config (&pci, PCI_REG_BAR0 + 4 * 4);
+  if ((bar4 & 1) == 0 || (bar4 & ~3u) == 0)
+    return 0;
+
+  command = pci_read_config (&pci, PCI_REG_COMMAND);
+  pci_write_config (&pci, PCI_REG_COMMAND,
+                    command | PCI_CMD_IO | PCI_CMD_MASTER);
+  return bar4 & ~3u;
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -289,6 +372,16 @@ identify_ata_device (struct ata_disk *d)
   snprintf (extra_info, sizeof extra_info,
             "model \"%s\", serial \"%s\"", model, serial);
 
+  /* Use DMA if the channel has a bus master and word 49 says
+     the disk supports DMA. */
+  if (c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x0100) != 0)
+    {
+      d->dma = true;
+      outb (reg_bm_status (c),
+            inb (reg_bm_status (c)) | (BM_STA_DMA0 << d->dev_no));
+      strlcat (extra_info, ", DMA", sizeof extra_info);
+    }
+
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
@@ -343,57 +436,120 @@ descramble_ata_string (char *string, int size)
    per-disk locking is unneeded. */
 static void
 ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d_, sec_no, &buffer, 1);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  void *buffers[1] = {(void *) buffer};
+  ide_write_multiple (d_, sec_no, buffers, 1);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFERS, one sector per buffer, with one command for each
+   IDE_MAX_SECTORS sectors.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, void *const buffers[],
+                   size_t cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (cnt > 0) 
+    {
+      size_t n = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      size_t i;
+
+      if (!d->dma || !dma_transfer (d, sec_no, buffers, n, false)) 
+        {
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+          for (i = 0; i < n; i++) 
+            {
+              sema_down (&c->completion_wait);
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              input_sector (c, buffers[i]);
+            }
+        }
+      sec_no += n;
+      buffers += n;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+/* Writes the CNT sectors starting at SEC_NO to disk D from
+   BUFFERS, one sector per buffer, with one command for each
+   IDE_MAX_SECTORS sectors.  Returns after the disk has
    acknowledged receiving the data.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write_multiple (void *d_, block_sector_t sec_no, void *const buffers[],
+                    size_t cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  while (cnt > 0) 
+    {
+      size_t n = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      size_t i;
+
+      if (!d->dma || !dma_transfer (d, sec_no, buffers, n, true)) 
+        {
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+          for (i = 0; i < n; i++) 
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              output_sector (c, buffers[i]);
+              sema_down (&c->completion_wait);
+            }
+        }
+      sec_no += n;
+      buffers += n;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the number of sectors to transfer, CNT, to
+   the disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= 256);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);            /* 256 is written as 0. */
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -430,6 +586,82 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Transfers the CNT sectors starting at SEC_NO of disk D to or
+   from BUFFERS, one sector per buffer, each of which must be in
+   kernel memory, by DMA: into BUFFERS if WRITE is false, out of
+   them if WRITE is true.  Returns true if successful.  On
+   failure, turns off DMA for D and returns false, so that the
+   caller can fall back to programmed I/O.  D's channel must be
+   locked. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no,
+              void *const buffers[], size_t cnt, bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t bm_status, status;
+  size_t i;
+  int n = 0;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (cnt > 0 && cnt <= IDE_MAX_SECTORS);
+
+  /* Describe the buffers, each of which is physically contiguous
+     because all of kernel memory is.  A buffer is split at a
+     64 kB boundary, and merged with the one before it if they
+     are adjacent. */
+  for (i = 0; i < cnt; i++) 
+    {
+      uintptr_t addr = vtop (buffers[i]);
+      size_t left = BLOCK_SECTOR_SIZE;
+
+      while (left > 0) 
+        {
+          size_t size = 0x10000 - (addr & 0xffff);
+          if (size > left)
+            size = left;
+          if (n > 0 && (addr & 0xffff) != 0
+              && c->prdt[n - 1].addr + c->prdt[n - 1].size == addr)
+            c->prdt[n - 1].size += size;
+          else 
+            {
+              ASSERT (n < PRD_CNT);
+              c->prdt[n].addr = addr;
+              c->prdt[n].size = size;
+              c->prdt[n].flags = 0;
+              n++;
+            }
+          addr += size;
+          left -= size;
+        }
+    }
+  c->prdt[n - 1].flags = PRD_EOT;
+
+  /* Set up the bus master, clearing any old error or interrupt,
+     then issue the command and start the transfer. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  outb (reg_bm_status (c),
+        inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+  sema_down (&c->completion_wait);
+
+  /* Stop the bus master and check for errors. */
+  outb (reg_bm_command (c), 0);
+  bm_status = inb (reg_bm_status (c));
+  status = inb (reg_alt_status (c));
+  outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+  if ((bm_status & BM_STA_ERR) || (status & (STA_ERR | STA_DRQ))) 
+    {
+      printf ("%s: DMA %s failed, sector=%"PRDSNu", using PIO\n",
+              d->name, write ? "write" : "read", sec_no);
+      d->dma = false;
+      return false;
+    }
+  return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
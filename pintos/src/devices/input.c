@@ -41,6 +41,43 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into DST and
+   returns the number retrieved.  If the buffer is empty, waits
+   for a key to be pressed; otherwise takes all the keys already
+   buffered at once, without waiting for more. */
+size_t
+input_read (void *dst, size_t size) 
+{
+  enum intr_level old_level;
+  size_t cnt;
+
+  old_level = intr_disable ();
+  cnt = intq_getbuf (&buffer, dst, size);
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Like input_read(), but returns 0 at once instead of waiting if
+   the input buffer is empty. */
+size_t
+input_try_read (void *dst, size_t size) 
+{
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  old_level = intr_disable ();
+  if (!intq_empty (&buffer)) 
+    {
+      cnt = intq_getbuf (&buffer, dst, size);
+      serial_notify ();
+    }
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
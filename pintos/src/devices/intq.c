@@ -54,6 +54,36 @@ intq_getc (struct intq *q)
   return byte;
 }
 
+/* Removes up to SIZE bytes from Q into BUF and returns the
+   number removed.  If Q is empty, sleeps until a byte is added;
+   otherwise takes only the bytes already in Q, without waiting
+   for more.  When called from an interrupt handler, Q must not be
+   empty. */
+size_t
+intq_getbuf (struct intq *q, uint8_t *buf, size_t size) 
+{
+  size_t cnt = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (size == 0)
+    return 0;
+  while (intq_empty (q)) 
+    {
+      ASSERT (!intr_context ());
+      lock_acquire (&q->lock);
+      wait (q, &q->not_empty);
+      lock_release (&q->lock);
+    }
+
+  while (cnt < size && !intq_empty (q))
+    {
+      buf[cnt++] = q->buf[q->tail];
+      q->tail = next (q->tail);
+    }
+  signal (q, &q->not_full);
+  return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
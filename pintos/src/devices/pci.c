@@ -0,0 +1,72 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* This code accesses PCI configuration space through
+   configuration mechanism #1, which every PC chipset since the
+   first PCI ones has supported.  See [PCI] 3.2.2.3.2. */
+
+/* I/O register addresses. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Selects configuration register. */
+#define PCI_CONFIG_DATA 0xcfc   /* Contains the selected register. */
+
+/* Number of buses we scan.  Virtual machines put every device
+   on bus 0. */
+#define PCI_BUS_CNT 1
+
+/* Selects configuration register REG of device D. */
+static void
+select_config (const struct pci_dev *d, int reg) 
+{
+  ASSERT (reg % 4 == 0 && reg < 256);
+  ASSERT (d->dev < 32 && d->func < 8);
+
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (d->bus << 16) | (d->dev << 11)
+                         | (d->func << 8) | reg);
+}
+
+/* Returns the 32-bit configuration register REG of device D. */
+uint32_t
+pci_read_config (const struct pci_dev *d, int reg) 
+{
+  select_config (d, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit configuration register REG of device D to
+   VALUE. */
+void
+pci_write_config (const struct pci_dev *d, int reg, uint32_t value) 
+{
+  select_config (d, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks for a function of the given CLASS and SUBCLASS.  If one
+   is found, stores its location in *D and returns true.
+   Otherwise, returns false. */
+bool
+pci_find_class (int class, int subclass, struct pci_dev *d) 
+{
+  for (d->bus = 0; d->bus < PCI_BUS_CNT; d->bus++)
+    for (d->dev = 0; d->dev < 32; d->dev++)
+      for (d->func = 0; d->func < 8; d->func++) 
+        {
+          uint32_t id = pci_read_config (d, PCI_REG_ID);
+          uint32_t cls;
+
+          /* No device answers with an all-ones vendor ID. */
+          if ((id & 0xffff) == 0xffff)
+            {
+              if (d->func == 0)
+                break;
+              continue;
+            }
+
+          cls = pci_read_config (d, PCI_REG_CLASS);
+          if ((int) (cls >> 24) == class
+              && (int) ((cls >> 16) & 0xff) == subclass)
+            return true;
+        }
+  return false;
+}
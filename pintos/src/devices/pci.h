@@ -0,0 +1,29 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function. */
+struct pci_dev
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t dev;                /* Device number, 0...31. */
+    uint8_t func;               /* Function number, 0...7. */
+  };
+
+/* Offsets of configuration space registers that we use. */
+#define PCI_REG_ID 0x00         /* Vendor ID (low), device ID (high). */
+#define PCI_REG_COMMAND 0x04    /* Command (low), status (high). */
+#define PCI_REG_CLASS 0x08      /* Revision, prog if, subclass, class. */
+#define PCI_REG_BAR0 0x10       /* First base address register. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Allow bus mastering. */
+
+uint32_t pci_read_config (const struct pci_dev *, int reg);
+void pci_write_config (const struct pci_dev *, int reg, uint32_t value);
+bool pci_find_class (int class, int subclass, struct pci_dev *);
+
+#endif /* devices/pci.h */
@@ -11,15 +11,12 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
      - Channel 0 is connected to interrupt line 0, so that it can
-       be used as a periodic timer interrupt, as implemented in
-       Pintos in devices/timer.c.
+       be used as a timer interrupt, as implemented in Pintos in
+       devices/timer.c.
 
      - Channel 1 is used for dynamic RAM refresh (in older PCs).
        No good can come of messing with this.
@@ -81,3 +78,46 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts a one-shot countdown of COUNT PIT cycles on the given
+   CHANNEL, using mode 0: the channel's output drops to 0 at once
+   and rises to 1 when the count reaches zero, raising an
+   interrupt if the channel is wired to one.  The counter then
+   keeps counting down, wrapping around from 0 to 0xffff, until
+   it is reloaded.  A COUNT of 0 is treated as 65536. */
+void
+pit_start_countdown (int channel, uint16_t count) 
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current count of the given CHANNEL and stores the
+   state of its output in *OUTPUT.  Uses the read-back command,
+   which latches the count and the status together so that they
+   agree with each other. */
+uint16_t
+pit_read_channel (int channel, bool *output) 
+{
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  *output = (status & 0x80) != 0;
+  return (hi << 8) | lo;
+}
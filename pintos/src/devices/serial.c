@@ -98,31 +98,56 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_write (&byte, 1);
+}
+
+/* Sends the SIZE bytes in BUFFER to the serial port.
+
+   In queued mode, the whole batch goes into the transmit queue
+   with interrupts disabled just once, and the interrupt enable
+   register, an I/O port write, is only updated when the queue
+   fills up or the batch is done, not for every byte. */
+void
+serial_write (const void *buffer, size_t size) 
+{
+  const uint8_t *p = buffer;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (size-- > 0)
+        putc_poll (*p++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* Otherwise, queue the bytes and update the interrupt
+         enable register. */
+      while (size-- > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (intq_full (&txq)) 
+            {
+              if (old_level == INTR_OFF)
+                {
+                  /* Interrupts are off and the transmit queue is
+                     full.  If we wanted to wait for the queue to
+                     empty, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a character
+                     via polling instead. */
+                  putc_poll (intq_getc (&txq)); 
+                }
+              else
+                {
+                  /* intq_putc() will wait for the transmit
+                     interrupt to make room. */
+                  write_ier ();
+                }
+            }
+          intq_putc (&txq, *p++); 
         }
-
-      intq_putc (&txq, byte); 
       write_ier ();
     }
   
@@ -130,7 +155,9 @@ serial_putc (uint8_t byte)
 }
 
 /* Flushes anything in the serial buffer out the port in polling
-   mode. */
+   mode.  The queue is drained oldest byte first, so everything
+   written before an exit or a panic still comes out ahead of the
+   messages that follow it. */
 void
 serial_flush (void) 
 {
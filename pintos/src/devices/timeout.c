@@ -0,0 +1,175 @@
+#include "devices/timeout.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* The timing wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots.
+   A slot in level 0 holds the timeouts due on one particular
+   tick, a slot in level 1 those due in one particular run of
+   WHEEL_SIZE ticks, and so on, with each level covering
+   WHEEL_SIZE times as long as the one below it.
+
+   A timeout goes into the lowest level that reaches far enough
+   ahead.  Whenever level 0 wraps around, the next slot of level
+   1 is "cascaded": its timeouts are redistributed into level 0,
+   and likewise for the higher levels.  Each timeout is thus
+   moved at most once per level, however long it waits.
+
+   With 4 levels of 64 slots, the wheel reaches 2**24 ticks, or
+   nearly two days, ahead.  A timeout further out than that waits
+   in the top level and is reinserted each time its slot comes
+   around. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* The last tick for which timeouts have been run. */
+static int64_t wheel_now;
+
+static void insert (struct timeout *);
+static void cascade (int level);
+
+/* Initializes the timing wheel. */
+void
+timeout_init (void) 
+{
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+}
+
+/* Arranges for FUNC to be called with timeout T, from the timer
+   interrupt, at timer tick EXPIRES, or at the next tick if
+   EXPIRES has already passed.  T's aux member is set to AUX.  T
+   must not already be pending. */
+void
+timeout_add (struct timeout *t, int64_t expires, timeout_func *func,
+             void *aux) 
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!t->pending);
+  t->expires = expires > wheel_now ? expires : wheel_now + 1;
+  t->func = func;
+  t->aux = aux;
+  t->pending = true;
+  insert (t);
+  intr_set_level (old_level);
+}
+
+/* Cancels timeout T.  Returns true if it was still pending,
+   false if it had already fired or was never added. */
+bool
+timeout_cancel (struct timeout *t) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = t->pending;
+
+  if (was_pending)
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Runs all the timeouts due at or before tick NOW.  Called from
+   the timer interrupt handler. */
+void
+timeout_run (int64_t now) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (wheel_now < now)
+    {
+      struct list *slot;
+      int level;
+
+      wheel_now++;
+
+      /* When a level wraps around, refill it from the next slot
+         of the level above. */
+      for (level = 1; level < WHEEL_LEVELS; level++)
+        {
+          if ((wheel_now >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK)
+            break;
+          cascade (level);
+        }
+
+      slot = &wheel[0][wheel_now & WHEEL_MASK];
+      while (!list_empty (slot))
+        {
+          struct timeout *t = list_entry (list_pop_front (slot),
+                                          struct timeout, elem);
+          ASSERT (t->expires == wheel_now);
+          t->pending = false;
+          t->func (t);
+        }
+    }
+}
+
+/* Returns the first tick after the last one run, but no later
+   than LIMIT, at which timeout_run() may have work to do, or
+   LIMIT if there is none.  Ticks at which a higher level is
+   cascaded are counted as having work, even if the slots to be
+   cascaded are empty, so LIMIT should not be far ahead. */
+int64_t
+timeout_next (int64_t limit) 
+{
+  int64_t t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (t = wheel_now + 1; t < limit; t++)
+    if ((t & WHEEL_MASK) == 0 || !list_empty (&wheel[0][t & WHEEL_MASK]))
+      return t;
+  return limit;
+}
+
+/* Puts T into the wheel slot for its expiration time, which
+   must not be before wheel_now. */
+static void
+insert (struct timeout *t) 
+{
+  int64_t delta = t->expires - wheel_now;
+  int64_t when = t->expires;
+  int level;
+
+  ASSERT (delta >= 0);
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+
+  /* Beyond the reach of the top level, park the timeout in the
+     last slot that level can reach. */
+  if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+    when = wheel_now + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+  list_push_back (&wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK],
+                  &t->elem);
+}
+
+/* Redistributes the timeouts in the current slot of LEVEL into
+   the levels below it. */
+static void
+cascade (int level) 
+{
+  struct list *slot
+    = &wheel[level][(wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK];
+  struct list pending;
+
+  list_init (&pending);
+  while (!list_empty (slot))
+    list_push_back (&pending, list_pop_front (slot));
+  while (!list_empty (&pending))
+    insert (list_entry (list_pop_front (&pending), struct timeout, elem));
+}
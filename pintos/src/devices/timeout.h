@@ -0,0 +1,38 @@
+#ifndef DEVICES_TIMEOUT_H
+#define DEVICES_TIMEOUT_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Timeouts.
+
+   A timeout calls a function from the timer interrupt handler
+   once the timer reaches a given tick.  The caller owns the
+   struct timeout, typically embedded in some larger structure,
+   and must keep it alive until it fires or is cancelled.
+
+   Pending timeouts are kept in a hierarchical timing wheel, so
+   adding or cancelling one takes constant time, and so does each
+   tick's work apart from the timeouts actually firing. */
+
+struct timeout;
+typedef void timeout_func (struct timeout *);
+
+struct timeout
+  {
+    struct list_elem elem;      /* Element in a wheel slot. */
+    int64_t expires;            /* Timer tick at which to fire. */
+    timeout_func *func;         /* Function to call. */
+    void *aux;                  /* For use by FUNC. */
+    bool pending;               /* Added and not yet fired? */
+  };
+
+void timeout_init (void);
+void timeout_add (struct timeout *, int64_t expires,
+                  timeout_func *, void *aux);
+bool timeout_cancel (struct timeout *);
+void timeout_run (int64_t now);
+int64_t timeout_next (int64_t limit);
+
+#endif /* devices/timeout.h */
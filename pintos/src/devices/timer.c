@@ -4,9 +4,10 @@
 #include <round.h>
 #include <stdio.h>
 #include "threads/interrupt.h"
-#include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "devices/pit.h"
+#include "devices/timeout.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,9 +18,53 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* The timer runs the PIT in one-shot mode, programming each
+   countdown to end at the next event: normally the next timer
+   tick, or sooner if a high-resolution sleeper is due first.
+   While the idle thread waits for an interrupt, the tick is
+   stopped and the countdown instead runs to the next timeout or
+   sleeper, or as far as the PIT's 16-bit counter reaches.  The
+   ticks skipped meanwhile are made up, and charged to the idle
+   thread, by the next interrupt of any kind. */
+
+/* PIT cycles per timer tick. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Shortest and longest countdowns, in PIT cycles.  The shortest
+   keeps a deadline that has just passed from flooding the CPU
+   with interrupts. */
+#define MIN_COUNTDOWN 32
+#define MAX_COUNTDOWN 0xffff
+
+/* Interrupt vector of the PIT's channel 0. */
+#define TIMER_VEC 0x20
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Number of timer interrupts since OS booted. */
+static int64_t interrupts;
+
+/* PIT cycles since OS booted as of the start of the current
+   countdown, and that countdown's length. */
+static uint64_t clock_base;
+static uint16_t countdown;
+
+/* True while the periodic tick is stopped for the idle thread. */
+static bool tickless;
+
+/* A thread sleeping until a point between two timer ticks. */
+struct hires_sleeper
+  {
+    struct list_elem elem;      /* Element in hires_list. */
+    uint64_t deadline;          /* PIT cycle count at which to wake. */
+    struct thread *thread;      /* The sleeping thread. */
+  };
+
+/* Sleepers ordered by deadline.  Only a thread's last fraction
+   of a tick is spent here, so the list stays short. */
+static struct list hires_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -29,22 +74,29 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static uint64_t clock_read (void);
+static void clock_update (void);
+static void program_countdown (void);
+static bool hires_deadline_less (const struct list_elem *,
+                                 const struct list_elem *, void *);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
+   interrupt TIMER_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  enum intr_level old_level;
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  timeout_init ();
+  list_init (&hires_list);
+
+  old_level = intr_disable ();
+  countdown = TICK_CYCLES;
+  pit_start_countdown (0, countdown);
+  intr_set_level (old_level);
 
-  intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  intr_register_ext (TIMER_VEC, timer_interrupt, "8254 Timer");
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -101,6 +153,8 @@ timer_sleep (int64_t ticks)
   int64_t start = timer_ticks ();
 
   ASSERT (intr_get_level () == INTR_ON);
+  if (ticks <= 0)
+    return;
   thread_sleep (start + ticks);
 }
 
@@ -168,19 +222,150 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Stops the periodic timer tick until the next timer event is
+   due.  Called by the idle thread, with interrupts off, just
+   before it halts the CPU.  The next interrupt restarts the tick
+   through timer_irq_enter(). */
+void
+timer_idle (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  tickless = true;
+  program_countdown ();
+}
+
+/* Called on entry to the handler for every external interrupt,
+   whose vector is VEC_NO.  If the tick was stopped by
+   timer_idle(), restarts it and makes up the ticks that were
+   skipped, so that the handler, and any thread it wakes, see the
+   current time.  The timer interrupt's own handler does the
+   catching up for it, so that the clock is only updated and the
+   PIT only reprogrammed once. */
+void
+timer_irq_enter (unsigned vec_no) 
+{
+  ASSERT (intr_context ());
+
+  if (tickless) 
+    {
+      tickless = false;
+      if (vec_no != TIMER_VEC)
+        clock_update ();
+    }
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" interrupts\n", interrupts);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
+  interrupts++;
+  clock_update ();
+}
+
+/* Returns the number of PIT cycles since the OS booted.
+   Interrupts must be off. */
+static uint64_t
+clock_read (void) 
+{
+  bool expired;
+  uint16_t count = pit_read_channel (0, &expired);
+
+  /* Once a countdown expires, the counter wraps around and keeps
+     counting down, so the time past expiry can be read too. */
+  if (expired)
+    return clock_base + countdown + (uint16_t) -count;
+  else
+    return clock_base + countdown - count;
+}
+
+/* Brings the tick count, and everything driven by it, up to date
+   with the PIT, wakes the high-resolution sleepers that are due,
+   and programs the next countdown.  Runs in an external interrupt
+   context. */
+static void
+clock_update (void) 
+{
+  uint64_t now = clock_read ();
+
+  /* Catching up on several ticks at once, as after a tickless
+     stretch, runs each tick's timeouts with timer_ticks() equal to
+     the tick they were due. */
+  while (ticks < (int64_t) (now / TICK_CYCLES)) 
+    {
+      ticks++;
+      thread_tick ();
+      timeout_run (ticks);
+    }
+
+  while (!list_empty (&hires_list)) 
+    {
+      struct hires_sleeper *s = list_entry (list_front (&hires_list),
+                                            struct hires_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hires_list);
+      thread_unblock (s->thread);
+      intr_yield_on_return ();
+    }
+
+  program_countdown ();
+}
+
+/* Starts a PIT countdown to the next timer event: the next tick,
+   or while tickless the next timeout, whichever is later, or the
+   first high-resolution sleeper's deadline if that is sooner.
+   Interrupts must be off. */
+static void
+program_countdown (void) 
+{
+  uint64_t now = clock_read ();
+  uint64_t next;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (tickless)
+    next = timeout_next (ticks + MAX_COUNTDOWN / TICK_CYCLES + 1)
+           * TICK_CYCLES;
+  else
+    next = (ticks + 1) * TICK_CYCLES;
+  if (!list_empty (&hires_list)) 
+    {
+      struct hires_sleeper *s = list_entry (list_front (&hires_list),
+                                            struct hires_sleeper, elem);
+      if (s->deadline < next)
+        next = s->deadline;
+    }
+
+  if (next < now + MIN_COUNTDOWN)
+    countdown = MIN_COUNTDOWN;
+  else if (next - now > MAX_COUNTDOWN)
+    countdown = MAX_COUNTDOWN;
+  else
+    countdown = next - now;
+  clock_base = now;
+  pit_start_countdown (0, countdown);
+}
+
+/* Returns true if high-resolution sleeper A's deadline is before
+   B's. */
+static bool
+hires_deadline_less (const struct list_elem *a_,
+                     const struct list_elem *b_, void *aux UNUSED) 
+{
+  const struct hires_sleeper *a = list_entry (a_, struct hires_sleeper,
+                                              elem);
+  const struct hires_sleeper *b = list_entry (b_, struct hires_sleeper,
+                                              elem);
+  return a->deadline < b->deadline;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -220,28 +405,53 @@ busy_wait (int64_t loops)
 static void
 real_time_sleep (int64_t num, int32_t denom) 
 {
-  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
+  /* Convert NUM/DENOM seconds into PIT cycles, rounding up so
+     that a sleep never ends early.  Scale the denominator down by
+     1000, as in real_time_delay(), to avoid the possibility of
+     overflow.
           
         (NUM / DENOM) s          
-     ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
-     1 s / TIMER_FREQ ticks
+     ---------------------- = NUM * PIT_HZ / DENOM cycles. 
+     1 s / PIT_HZ cycles
   */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t cycles;
+  struct hires_sleeper s;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  ASSERT (denom % 1000 == 0);
+  if (num <= 0)
+    return;
+  cycles = DIV_ROUND_UP (DIV_ROUND_UP (num * PIT_HZ, 1000), denom / 1000);
+
+  /* A sleep shorter than the shortest countdown would spend
+     longer blocking and switching threads than sleeping, so
+     busy-wait instead. */
+  if (cycles < MIN_COUNTDOWN) 
     {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */                
-      timer_sleep (ticks); 
+      real_time_delay (num, denom);
+      return;
     }
-  else 
+
+  old_level = intr_disable ();
+  s.deadline = clock_read () + cycles;
+  s.thread = thread_current ();
+
+  /* Sleep through the whole ticks on the timing wheel, waking on
+     the last tick boundary before the deadline... */
+  if ((int64_t) (s.deadline / TICK_CYCLES) > ticks)
+    thread_sleep (s.deadline / TICK_CYCLES);
+
+  /* ...then sleep through the rest of the last tick, with the
+     timer programmed to interrupt at the deadline itself. */
+  if (clock_read () < s.deadline) 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      list_insert_ordered (&hires_list, &s.elem, hires_deadline_less,
+                           NULL);
+      program_countdown ();
+      thread_block ();
     }
+  intr_set_level (old_level);
 }
 
 /* Busy-wait for approximately NUM/DENOM seconds. */
@@ -24,5 +24,9 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Tickless idle. */
+void timer_idle (void);
+void timer_irq_enter (unsigned vec_no);
+
 void timer_print_stats (void);
 #endif /* devices/timer.h */
@@ -1,6 +1,9 @@
 #ifndef DEVICES_VGA_H
 #define DEVICES_VGA_H
 
+#include <stddef.h>
+
 void vga_putc (int);
+void vga_write (const char *, size_t);
 
 #endif /* devices/vga.h */
@@ -1,7 +1,19 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
+#include <stdlib.h>
 #include <string.h>
 #define WB_TIME 1000
+static struct work write_behind_work;
+static struct work read_ahead_work;
+static struct lock_stats bc_lock_stats;
+static struct lock_stats ra_lock_stats;
+
+/* cache_read() calls, how many of them released bc_lock while
+   other threads were waiting for it, and the context switches
+   taken during those releases. */
+static unsigned long read_cnt;
+static unsigned long contended_releases;
+static long long release_switches;
 void init_bce(struct bce* b)
 {
     b->accessed = false;
@@ -10,36 +22,33 @@ void init_bce(struct bce* b)
     b->pinned = false;
     b->sector = 0;
     memset(b->data, 0, 512);
-    sema_init(&b->rs,1);
-    sema_init(&b->rws,1);
-    b->read_count = 0;
+    rwlock_init(&b->rw);
 }
 void flush_bce(struct bce* b)
 {
-    sema_down(&b->rs);
-    sema_down(&b->rws);
+    rwlock_write_acquire(&b->rw);
     b->accessed = false;
     b->dirty = false;
     b->valid = false;
     b->pinned = false;
-    b->read_count = 0;
     memset(b->data, 0, 512);
-    sema_up(&b->rs);
-    sema_up(&b->rws);
+    rwlock_write_release(&b->rw);
 }
 void bc_init()
 {
     int i;
     lock_init(&bc_lock);
+    lock_profile(&bc_lock, &bc_lock_stats, "bc_lock");
     for(i=0;i<64;i++)
     {
         init_bce(&buffer_cache[i]);
     }
-    sema_init(&ra_sema,0);
-    list_init(&ra_list);
+    ra_head = ra_cnt = 0;
     lock_init(&ra_lock);
-    thread_create("bc_write_behind", PRI_DEFAULT, thread_func_write_behind, NULL);
-    thread_create("read_ahead", PRI_DEFAULT, thread_func_read_ahead, NULL);
+    lock_profile(&ra_lock, &ra_lock_stats, "ra_lock");
+    work_init(&write_behind_work, cache_write_behind, NULL);
+    work_init(&read_ahead_work, cache_read_ahead, NULL);
+    work_queue_delayed(&write_behind_work, WB_TIME);
 }
 int get_bce_idx(block_sector_t s, bool pin)
 {
@@ -74,33 +83,23 @@ void bce_read(struct bce* b,const uint8_t* buffer_, off_t size, off_t ofs)
     //printf("bce read called\n");
     if(512 - ofs < size)
         PANIC("read beyond cache block\n");
-    sema_down(&b->rs);
-    b->read_count++;
-    if(b->read_count == 1)// first reader
-        sema_down(&b->rws);
-    sema_up(&b->rs);
+    rwlock_read_acquire(&b->rw);
     memcpy(buffer, &b->data[ofs] , size);//read performed
     b->accessed = true;
-    sema_down(&b->rs);
-    b->read_count--;
-    if(b->read_count == 0)//last reader
-    {
-        sema_up(&b->rws);
-        b->pinned = false;
-    }
-    sema_up(&b->rs);
+    b->pinned = false;
+    rwlock_read_release(&b->rw);
 }
 void bce_write(struct bce* b,const uint8_t* buffer_, off_t size, off_t ofs)
 {
     uint8_t *buffer = buffer_;
      if(512 - ofs < size)
         PANIC("write beyond cache block\n");
-     sema_down(&b->rws);
+     rwlock_write_acquire(&b->rw);
      memcpy(&b->data[ofs], buffer, size);
      b->dirty = true;
      b->accessed = true;
      b->pinned = false;
-     sema_up(&b->rws);
+     rwlock_write_release(&b->rw);
 }
 int cache_evict()
 {
@@ -118,11 +117,11 @@ int cache_evict()
         }
         if(buffer_cache[i].dirty)
         {
-            sema_down(&buffer_cache[i].rws);
+            rwlock_read_acquire(&buffer_cache[i].rw);
             //printf("evict sector %d\n",buffer_cache[i].sector);
             block_write(fs_device, buffer_cache[i].sector,
                     buffer_cache[i].data);
-            sema_up(&buffer_cache[i].rws);
+            rwlock_read_release(&buffer_cache[i].rw);
         }
         flush_bce(&buffer_cache[i]);
         return i;
@@ -169,60 +168,167 @@ void cache_read(block_sector_t sector_idx,const uint8_t *buffer_, off_t ofs, off
 //        printf("read get %d\n",idx);
         get_from_block(sector_idx, idx);
     }
-    lock_release(&bc_lock);
+    read_cnt++;
+    if(!list_empty(&bc_lock.semaphore.waiters))
+    {
+        long long switches = thread_switch_count();
+        contended_releases++;
+        lock_release(&bc_lock);
+        release_switches += thread_switch_count() - switches;
+    }
+    else
+        lock_release(&bc_lock);
 //    printf("bce read %d\n", idx);
     bce_read(&buffer_cache[idx], buffer, size, ofs);
 }
-void thread_func_write_behind(void* aux UNUSED)
+/* qsort() comparison for cache entry indexes, by sector. */
+static int compare_bce_sectors(const void *a_, const void *b_)
+{
+    const int *a = a_, *b = b_;
+    block_sector_t sa = buffer_cache[*a].sector;
+    block_sector_t sb = buffer_cache[*b].sector;
+    return sa < sb ? -1 : sa > sb;
+}
+/* qsort() comparison for sector numbers. */
+static int compare_sectors(const void *a_, const void *b_)
 {
+    const block_sector_t *a = a_, *b = b_;
+    return *a < *b ? -1 : *a > *b;
+}
+/* Writes the RUN_CNT entries in RUN, which hold consecutive
+   sectors and which we hold for reading, to disk with one
+   request, then marks them clean and releases them. */
+static void write_run(int run[], int run_cnt)
+{
+    void *buffers[CACHE_RUN_MAX];
     int i;
-    while(1)
+    if(run_cnt == 0)
+        return;
+    for(i=0;i<run_cnt;i++)
+        buffers[i] = buffer_cache[run[i]].data;
+    block_write_multiple(fs_device, buffer_cache[run[0]].sector,
+            buffers, run_cnt);
+    for(i=0;i<run_cnt;i++)
     {
-        timer_sleep(WB_TIME);
-        for(i=0;i<64;i++)
+        buffer_cache[run[i]].dirty = false;
+        rwlock_read_release(&buffer_cache[run[i]].rw);
+    }
+}
+/* Writes dirty cache entries back to disk, in order by sector,
+   one request for each run of consecutive sectors, then queues
+   itself to run again WB_TIME ticks later. */
+void cache_write_behind(struct work *w)
+{
+    int order[64], run[CACHE_RUN_MAX];
+    int cnt = 0, run_cnt = 0;
+    int i;
+    for(i=0;i<64;i++)
+        if(buffer_cache[i].dirty)
+            order[cnt++] = i;
+    qsort(order, cnt, sizeof *order, compare_bce_sectors);
+    for(i=0;i<cnt;i++)
+    {
+        struct bce *b = &buffer_cache[order[i]];
+        /* Writers are shut out while we hold the entry for
+           reading, so clearing dirty cannot lose a write.  The
+           entry may have been written back or reused since we
+           looked, so look again. */
+        rwlock_read_acquire(&b->rw);
+        if(!b->dirty || !b->valid)
         {
-            if(buffer_cache[i].dirty)
-            {
-                sema_down(&buffer_cache[i].rws);
-                block_write(fs_device, buffer_cache[i].sector, buffer_cache[i].data);
-                buffer_cache[i].dirty = false;
-                sema_up(&buffer_cache[i].rws);
-            }
+            rwlock_read_release(&b->rw);
+            continue;
         }
+        if(run_cnt > 0 && (run_cnt == CACHE_RUN_MAX
+                || b->sector != buffer_cache[run[0]].sector + run_cnt))
+        {
+            write_run(run, run_cnt);
+            run_cnt = 0;
+        }
+        run[run_cnt++] = order[i];
     }
+    write_run(run, run_cnt);
+    work_queue_delayed(w, WB_TIME);
 }
-void make_read_ahead(block_sector_t s)
+/* Reads the RUN_CNT sectors starting at FIRST into the cache
+   entries in RUN, which have been set aside for them, with one
+   request.  bc_lock must be held. */
+static void read_run(block_sector_t first, int run[], int run_cnt)
 {
-
+    void *buffers[CACHE_RUN_MAX];
+    int i;
+    if(run_cnt == 0)
+        return;
+    for(i=0;i<run_cnt;i++)
+        buffers[i] = buffer_cache[run[i]].data;
+    block_read_multiple(fs_device, first, buffers, run_cnt);
+    for(i=0;i<run_cnt;i++)
+        buffer_cache[run[i]].pinned = false;
 }
-void thread_func_read_ahead (void *aux UNUSED)
+/* Brings the CNT SECTORS into the cache, if they are not there
+   already.  Each run of consecutive sectors that are missing is
+   read with one request, so SECTORS should be in ascending
+   order. */
+void cache_prefetch(const block_sector_t sectors[], int cnt)
 {
-    int idx;
-    struct list_elem *e;
-    struct ra_elem *r;
-    block_sector_t sector_idx;
-    
-while(1)
-{
-    sema_down(&ra_sema);
-    lock_acquire(&ra_lock);
-    while(!list_empty(&ra_list))
+    int run[CACHE_RUN_MAX];
+    block_sector_t first = 0;
+    int run_cnt = 0;
+    int i, idx;
+    lock_acquire(&bc_lock);
+    for(i=0;i<cnt;i++)
     {
-        e = list_pop_front(&ra_list);
-        r = (struct ra_elem*)list_entry(e, struct ra_elem, elem);
-        sector_idx = r->s;
-        free(r);
-        lock_acquire(&bc_lock);
-        idx = get_bce_idx(sector_idx,false);
-        if(idx == -1)
-        {   
-            idx = cache_evict();
-            get_from_block(sector_idx, idx);
+        if(get_bce_idx(sectors[i],false) != -1)
+            continue;
+        if(run_cnt > 0 && (run_cnt == CACHE_RUN_MAX
+                || sectors[i] != first + run_cnt))
+        {
+            read_run(first, run, run_cnt);
+            run_cnt = 0;
         }
-        lock_release(&bc_lock);
+        if(run_cnt == 0)
+            first = sectors[i];
+        /* Claim an entry, pinned so that the rest of the run
+           cannot evict it before it is read. */
+        idx = cache_evict();
+        buffer_cache[idx].valid = true;
+        buffer_cache[idx].sector = sectors[i];
+        buffer_cache[idx].pinned = true;
+        run[run_cnt++] = idx;
     }
+    read_run(first, run, run_cnt);
+    lock_release(&bc_lock);
+}
+/* Asks for sector S to be read into the cache in the background.
+   Requests made before the read-ahead work runs are batched into
+   one run; if RA_MAX are already waiting, S is dropped. */
+void make_read_ahead(block_sector_t s)
+{
+    lock_acquire(&ra_lock);
+    if(ra_cnt < RA_MAX)
+        ra_ring[(ra_head + ra_cnt++) % RA_MAX] = s;
+    lock_release(&ra_lock);
+    work_queue(&read_ahead_work);
+}
+/* Reads the sectors requested by make_read_ahead() into the
+   cache.  Takes the whole batch at once, so that readers queuing
+   more requests do not wait behind the disk, and reads each run
+   of consecutive sectors in it with one request. */
+void cache_read_ahead (struct work *w UNUSED)
+{
+    block_sector_t batch[RA_MAX];
+    int cnt, i;
+
+    lock_acquire(&ra_lock);
+    cnt = ra_cnt;
+    for(i=0;i<cnt;i++)
+        batch[i] = ra_ring[(ra_head + i) % RA_MAX];
+    ra_head = (ra_head + cnt) % RA_MAX;
+    ra_cnt = 0;
     lock_release(&ra_lock);
-}   
+
+    qsort(batch, cnt, sizeof *batch, compare_sectors);
+    cache_prefetch(batch, cnt);
 }
 void write_back_all()
 {
@@ -239,3 +345,26 @@ void write_back_all()
     lock_release(&bc_lock);
 
 }
+
+/* Prints buffer cache lock statistics, summed over all the
+   cache entries. */
+void
+cache_print_stats (void)
+{
+    unsigned long reads = 0, writes = 0, read_waits = 0, write_waits = 0;
+    int i;
+
+    for(i=0;i<64;i++)
+    {
+        reads += buffer_cache[i].rw.read_cnt;
+        writes += buffer_cache[i].rw.write_cnt;
+        read_waits += buffer_cache[i].rw.read_waits;
+        write_waits += buffer_cache[i].rw.write_waits;
+    }
+    printf("Cache: %lu entry reads (%lu waited), "
+           "%lu entry writes (%lu waited)\n",
+           reads, read_waits, writes, write_waits);
+    printf("Cache: %lu reads, %lu released bc_lock to waiters "
+           "with %lld context switches\n",
+           read_cnt, contended_releases, release_switches);
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 #include "devices/block.h"
 #include "devices/timer.h"
 #include <list.h>
@@ -14,26 +15,28 @@ struct bce{
     bool valid;
     bool pinned;
     block_sector_t sector;
-    struct semaphore rs;
-    struct semaphore rws;
-    int read_count;
-};
-struct ra_elem{
-    block_sector_t s;
-    struct list_elem elem;
+    struct rwlock rw;
 };
 struct lock bc_lock;
 struct bce buffer_cache[64];
 
-struct semaphore ra_sema;
-struct list ra_list;
+/* Sectors waiting to be read ahead, oldest first, in a ring of
+   RA_MAX.  Requests beyond that are dropped. */
+#define RA_MAX 32
+block_sector_t ra_ring[RA_MAX];
+/* Most sectors moved between the cache and disk by one request. */
+#define CACHE_RUN_MAX 16
+int ra_head;
+int ra_cnt;
 struct lock ra_lock;
 void init_bce(struct bce* b);
 void bc_init(void);
-void thread_func_write_behind (void *aux);
+void cache_write_behind (struct work *w);
 void make_read_ahead(block_sector_t s);
-void thread_func_read_ahead (void *aux);
+void cache_read_ahead (struct work *w);
+void cache_prefetch (const block_sector_t sectors[], int cnt);
 void cache_write(block_sector_t sector_idx,const uint8_t *buffer_, off_t ofs, off_t size);
 void cache_read(block_sector_t sector_idx,const uint8_t *buffer_, off_t ofs, off_t size);
 void write_back_all();
+void cache_print_stats (void);
 #endif
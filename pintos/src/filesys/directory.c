@@ -4,7 +4,8 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "filesys/file.h"
+#include "threads/slab.h"
 
 /* A directory. */
 struct dir 
@@ -38,17 +39,21 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir;
+
+  ASSERT (sizeof *dir <= file_cache.obj_size);
+  dir = slab_alloc (&file_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
       dir->pos = 0;
+      dir->fake_deny_write = false;
       return dir;
     }
   else
     {
       inode_close (inode);
-      free (dir);
+      slab_free (&file_cache, dir);
       return NULL; 
     }
 }
@@ -76,7 +81,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      slab_free (&file_cache, dir);
     }
 }
 
@@ -1,7 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file 
@@ -11,13 +11,24 @@ struct file
     bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+/* Cache of open files.  Directories are allocated from it too,
+   since an open directory may be closed with file_close(). */
+struct slab_cache file_cache;
+
+/* Initializes the open file cache. */
+void
+file_init (void) 
+{
+  slab_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = slab_alloc (&file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
@@ -29,7 +40,7 @@ file_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (file);
+      slab_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -54,7 +65,7 @@ file_close (struct file *file)
 //      printf("2 inode sector = %d\n",get_sector(file->inode));
       inode_close (file->inode);
 //      printf("2 inode sector = %d\n",get_sector(file->inode));
-      free (file);
+      slab_free (&file_cache, file);
 //      printf("123\n");
     }
 }
@@ -90,6 +101,19 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the IOVCNT segments of IOV, filling each
+   segment in turn, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than requested if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt) 
+{
+  off_t bytes_read = inode_readv_at (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
@@ -119,6 +143,19 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes the IOVCNT segments of IOV into FILE back to back,
+   starting at the file's current position, as a single inode
+   operation.
+   Returns the number of bytes actually written.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt) 
+{
+  off_t bytes_written = inode_writev_at (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -5,6 +5,12 @@
 #include <stdint.h>
 #include "filesys/inode.h"
 struct inode;
+struct iovec;
+
+/* Cache that open files and directories are allocated from. */
+extern struct slab_cache file_cache;
+void file_init (void);
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -16,6 +22,8 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int iovcnt);
+off_t file_writev (struct file *, const struct iovec *, int iovcnt);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
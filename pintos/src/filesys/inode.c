@@ -1,11 +1,13 @@
 #include "filesys/inode.h"
 #include <list.h>
 #include <debug.h>
+#include <iovec.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "filesys/cache.h"
 
 /* Identifies an inode. */
@@ -54,6 +56,7 @@ struct inode
     block_sector_t bd;
     int bt_num;
     int alloc_num;
+    struct seqlock seq;                 /* Guards growth of the fields below. */
     struct inode_disk data;             /* Inode content. */
     struct BD block_directory;
   };
@@ -140,11 +143,26 @@ bd_byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of in-memory inodes.  A `struct inode' is a little over
+   1 kB, so malloc() would give each one a whole page. */
+static struct slab_cache inode_cache;
+
+/* Constructs inode OBJ in inode_cache.  The seqlock is left
+   unlocked by inode_close(), so it survives reuse. */
+static void
+inode_ctor (void *obj) 
+{
+  struct inode *inode = obj;
+  seqlock_init (&inode->seq);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode),
+                   inode_ctor);
   bc_init();
 }
 void close_bd(struct inode* inode)
@@ -257,7 +275,7 @@ bool file_growth(struct inode* inode, size_t size)
     block_sector_t *temp;
     struct BD* bdp;
     static char zeros[BLOCK_SECTOR_SIZE];
-    length = inode_length(inode);
+    length = inode->data.length;
     how_much = size - length;
     add_sectors = bytes_to_sectors(size) - bytes_to_sectors(length);
     new_bt_num = DIV_ROUND_UP(bytes_to_sectors(size) , BLOCK_ENTRY_NUM);
@@ -428,7 +446,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -490,7 +508,7 @@ inode_close (struct inode *inode)
           //                  bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      slab_free (&inode_cache, inode); 
     }
 }
 
@@ -509,9 +527,47 @@ inode_remove (struct inode *inode)
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
-  uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = buffer_;
+  iov.iov_len = size;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOVCNT segments of IOV, filling each
+   segment in turn, starting at position OFFSET.  The whole
+   transfer is a single pass over the inode's sectors.
+   Returns the number of bytes actually read, which may be less
+   than the total length of IOV if an error occurs or end of file
+   is reached. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                off_t offset)
+{
+  off_t size = iov_length (iov, iovcnt);
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  int seg = 0;
+  size_t seg_ofs = 0;
+  off_t length = inode_length (inode);
+
+  /* Bring the sectors that the read covers into the cache first,
+     so that those not there yet, such as a page of an executable
+     being loaded, are read from disk a run at a time. */
+  if (size > 0 && offset < length) 
+    {
+      block_sector_t sectors[CACHE_RUN_MAX];
+      off_t end = size < length - offset ? offset + size : length;
+      off_t pos;
+      int cnt = 0;
+
+      for (pos = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+           pos < end && cnt < CACHE_RUN_MAX; pos += BLOCK_SECTOR_SIZE)
+        sectors[cnt++] = bd_byte_to_sector (inode, pos);
+      if (cnt > 1)
+        cache_prefetch (sectors, cnt);
+    }
 
   while (size > 0 && offset<inode_length(inode)) 
     {
@@ -528,44 +584,26 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-  /*  
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          // Read full sector directly into caller's buffer. 
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
+
+      /* Never copy past the end of the current segment. */
+      while (seg_ofs == iov[seg].iov_len)
         {
-          // Read sector into bounce buffer, then partially copy
-           //  into caller's buffer.
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          seg++;
+          seg_ofs = 0;
         }
-*/
-      cache_read(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+      if ((size_t) chunk_size > iov[seg].iov_len - seg_ofs)
+        chunk_size = iov[seg].iov_len - seg_ofs;
+
+      cache_read(sector_idx, (uint8_t *) iov[seg].iov_base + seg_ofs,
+                 sector_ofs, chunk_size);
         if(size - chunk_size > 0)
-        {
-            struct ra_elem *r;
-            r = (struct ra_elem*)malloc(sizeof(struct ra_elem));
-            r->s = bd_byte_to_sector (inode, offset + chunk_size);
-            lock_acquire(&ra_lock);
-            list_push_back(&ra_list,&r->elem);
-            lock_release(&ra_lock);
-            sema_up(&ra_sema);
-            // index file system
-        }
+            make_read_ahead(bd_byte_to_sector (inode, offset + chunk_size));
       // Advance. 
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
+      seg_ofs += chunk_size;
     }
-//  free (bounce);
 
   return bytes_read;
 }
@@ -573,15 +611,33 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   Writing past end of file extends the inode. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = (void *) buffer_;
+  iov.iov_len = size;
+  return inode_writev_at (inode, &iov, 1, offset);
+}
+
+/* Writes the IOVCNT segments of IOV back to back into INODE,
+   starting at OFFSET.  The inode is extended at most once, to
+   cover the whole transfer, before any data is written.
+   Returns the number of bytes actually written, which may be
+   less than the total length of IOV if an error occurs. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                 off_t offset)
+{
+  off_t size = iov_length (iov, iovcnt);
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  int seg = 0;
+  size_t seg_ofs = 0;
 
   if (inode->deny_write_cnt)
     return 0;
@@ -590,9 +646,15 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   {
       if(offset+size > MAX_FILE_SIZE)
           PANIC("two large file\n");
-  //    printf("size-length in write = %d\n", offset+size - inode_length(inode));
-      if(!file_growth(inode, offset + size))
+
+      /* Readers see the old length until the new sectors are in
+         place.  Another writer may have grown the inode while we
+         waited, so check again. */
+      seqlock_write_begin (&inode->seq);
+      if(offset+size > inode->data.length
+         && !file_growth(inode, offset + size))
           PANIC("file_growth fail\n");
+      seqlock_write_end (&inode->seq);
   }
 
   while (size > 0) 
@@ -610,40 +672,24 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-/*
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+
+      /* Never copy past the end of the current segment. */
+      while (seg_ofs == iov[seg].iov_len)
         {
-         // Write full sector directly to disk. 
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          seg++;
+          seg_ofs = 0;
         }
-      else 
-        {
-          // We need a bounce buffer. 
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+      if ((size_t) chunk_size > iov[seg].iov_len - seg_ofs)
+        chunk_size = iov[seg].iov_len - seg_ofs;
 
-          // If the sector contains data before or after the chunk
-          //   we're writing, then we need to read in the sector
-          //   first.  Otherwise we start with a sector of all zeros.
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
-*/
-    cache_write(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+      cache_write(sector_idx, (uint8_t *) iov[seg].iov_base + seg_ofs,
+                  sector_ofs, chunk_size);
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
+      seg_ofs += chunk_size;
     }
-  //free (bounce);
 
   return bytes_written;
 }
@@ -672,5 +718,15 @@ inode_allow_write (struct inode *inode)
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->data.length;
+  struct seqlock *seq = (struct seqlock *) &inode->seq;
+  unsigned s;
+  off_t length;
+
+  do 
+    {
+      s = seqlock_read_begin (seq);
+      length = inode->data.length;
+    }
+  while (seqlock_read_retry (seq, s));
+  return length;
 }
@@ -6,6 +6,7 @@
 #include "devices/block.h"
 
 struct bitmap;
+struct iovec;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, int,block_sector_t);
@@ -16,6 +17,10 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iovcnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iovcnt,
+                       off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
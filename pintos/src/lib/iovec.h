@@ -0,0 +1,33 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+/* Scatter/gather buffer lists for the readv() and writev()
+   system calls.  Shared between the kernel and user programs. */
+
+#include <stddef.h>
+
+/* One segment of a buffer list. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the segment. */
+    size_t iov_len;             /* Length of the segment in bytes. */
+  };
+
+/* Maximum number of segments accepted by one readv() or
+   writev() call. */
+#define IOV_MAX 1024
+
+/* Returns the total number of bytes in the IOVCNT segments of
+   IOV. */
+static inline size_t
+iov_length (const struct iovec *iov, int iovcnt)
+{
+  size_t length = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+  return length;
+}
+
+#endif /* lib/iovec.h */
@@ -289,6 +289,31 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or BITMAP_ERROR if there is none.  Looks at a
+   whole element at a time, so it takes time proportional to the
+   number of elements scanned, not bits. */
+static size_t
+scan_one (const struct bitmap *b, size_t start, bool value) 
+{
+  size_t idx;
+
+  for (idx = elem_idx (start); idx < elem_cnt (b->bit_cnt); idx++) 
+    {
+      elem_type bits = value ? b->bits[idx] : ~b->bits[idx];
+      if (idx == elem_idx (start))
+        bits &= (elem_type) -1 << (start % ELEM_BITS);
+      if (bits != 0) 
+        {
+          /* A match past the end is in the unused bits of the
+             last element, so there is no real match. */
+          size_t bit_idx = idx * ELEM_BITS + __builtin_ctzl (bits);
+          return bit_idx < b->bit_cnt ? bit_idx : BITMAP_ERROR;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -299,6 +324,8 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 1)
+    return scan_one (b, start, value);
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
@@ -1,5 +1,36 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move and compare 32-bit words with
+   the x86 string instructions, after first handling any bytes
+   needed to word-align the destination, since sector buffers and
+   pages are copied and cleared on many hot paths.
+
+   A 32-bit word that may alias objects of any type. */
+typedef uint32_t __attribute__ ((may_alias)) word_t;
+
+/* Copies SIZE bytes from SRC to DST, lowest address first.  The
+   blocks may overlap only if DST is below SRC. */
+static void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) 
+{
+  size_t head = -(uintptr_t) dst % sizeof (word_t);
+  size_t words;
+
+  if (head > size)
+    head = size;
+  size -= head;
+  words = size / sizeof (word_t);
+  size %= sizeof (word_t);
+
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +43,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  copy_forward (dst, src, size);
 
   return dst_;
 }
@@ -29,20 +59,27 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
+  if (dst < src || dst >= src + size) 
+    copy_forward (dst, src, size);
   else 
     {
+      /* Copy the odd bytes at the end, then whole words going
+         down.  The interrupt stubs clear the direction flag on
+         entry, and iret restores it. */
+      size_t words = size / sizeof (word_t);
+
       dst += size;
       src += size;
-      while (size-- > 0)
+      for (size %= sizeof (word_t); size > 0; size--)
         *--dst = *--src;
+
+      dst -= sizeof (word_t);
+      src -= sizeof (word_t);
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
     }
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -55,9 +92,24 @@ memcmp (const void *a_, const void *b_, size_t size)
   const unsigned char *a = a_;
   const unsigned char *b = b_;
 
+  size_t words = size / sizeof (word_t);
+
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip past equal words.  The comparison stops just after the
+     first unequal word, or after the last word, so back up one
+     word and find the differing byte, if any, the slow way. */
+  if (words > 0) 
+    {
+      size_t left = words;
+      asm volatile ("repe cmpsl"
+                    : "+S" (a), "+D" (b), "+c" (left) : : "memory", "cc");
+      a -= sizeof (word_t);
+      b -= sizeof (word_t);
+      size -= (words - left - 1) * sizeof (word_t);
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -279,11 +331,24 @@ void *
 memset (void *dst_, int value, size_t size) 
 {
   unsigned char *dst = dst_;
+  uint32_t pattern = (unsigned char) value * 0x01010101u;
+  size_t head = -(uintptr_t) dst % sizeof (word_t);
+  size_t words;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
+
+  if (head > size)
+    head = size;
+  size -= head;
+  words = size / sizeof (word_t);
+  size %= sizeof (word_t);
+
+  asm volatile ("rep stosb" : "+D" (dst), "+c" (head) : "a" (pattern)
+                : "memory");
+  asm volatile ("rep stosl" : "+D" (dst), "+c" (words) : "a" (pattern)
+                : "memory");
+  asm volatile ("rep stosb" : "+D" (dst), "+c" (size) : "a" (pattern)
+                : "memory");
 
   return dst_;
 }
@@ -296,8 +361,22 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Check a word at a time once aligned.  An aligned word never
+     crosses a page boundary, so reading past the null terminator
+     is safe.  (W - 0x01010101) & ~W & 0x80808080 is nonzero just
+     when some byte of W is zero. */
+  for (p = string; (uintptr_t) p % sizeof (word_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  for (;;) 
+    {
+      word_t w = *(const word_t *) p;
+      if ((w - 0x01010101u) & ~w & 0x80808080u)
+        break;
+      p += sizeof (word_t);
+    }
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
@@ -0,0 +1,51 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Contention for bc_lock depends on where timer interrupts land,
+# so the counts vary from run to run.  Only a handful of the
+# contended releases may switch threads, through a time slice
+# happening to end during the release.
+my ($stats) = grep (/^Cache: \d+ reads, /, @output);
+fail "missing cache read statistics\n" if !defined $stats;
+my ($reads, $contended, $switches) = $stats =~
+  /^Cache: (\d+) reads, (\d+) released bc_lock to waiters with (\d+) context switches$/
+  or fail "malformed cache read statistics: $stats\n";
+fail "only $reads cache reads, expected at least 10240\n"
+  if $reads < 10240;
+fail "$switches context switches in $contended contended bc_lock releases\n"
+  if $switches > 5 + $contended / 10;
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(syn-read-switch) begin
+(syn-read-switch) create "data"
+(syn-read-switch) open "data"
+(syn-read-switch) write "data"
+(syn-read-switch) close "data"
+(syn-read-switch) exec child 1 of 10: "child-syn-read 0"
+(syn-read-switch) exec child 2 of 10: "child-syn-read 1"
+(syn-read-switch) exec child 3 of 10: "child-syn-read 2"
+(syn-read-switch) exec child 4 of 10: "child-syn-read 3"
+(syn-read-switch) exec child 5 of 10: "child-syn-read 4"
+(syn-read-switch) exec child 6 of 10: "child-syn-read 5"
+(syn-read-switch) exec child 7 of 10: "child-syn-read 6"
+(syn-read-switch) exec child 8 of 10: "child-syn-read 7"
+(syn-read-switch) exec child 9 of 10: "child-syn-read 8"
+(syn-read-switch) exec child 10 of 10: "child-syn-read 9"
+(syn-read-switch) wait for child 1 of 10 returned 0 (expected 0)
+(syn-read-switch) wait for child 2 of 10 returned 1 (expected 1)
+(syn-read-switch) wait for child 3 of 10 returned 2 (expected 2)
+(syn-read-switch) wait for child 4 of 10 returned 3 (expected 3)
+(syn-read-switch) wait for child 5 of 10 returned 4 (expected 4)
+(syn-read-switch) wait for child 6 of 10 returned 5 (expected 5)
+(syn-read-switch) wait for child 7 of 10 returned 6 (expected 6)
+(syn-read-switch) wait for child 8 of 10 returned 7 (expected 7)
+(syn-read-switch) wait for child 9 of 10 returned 8 (expected 8)
+(syn-read-switch) wait for child 10 of 10 returned 9 (expected 9)
+(syn-read-switch) end
+EOF
+pass;
@@ -0,0 +1,188 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp() and strlen()
+   against simple byte-at-a-time versions, for every small size
+   and every alignment of source and destination, then reports
+   how many cycles each takes, against the byte-at-a-time
+   version, at a range of sizes.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "threads/tsc.h"
+
+/* Largest size checked at every alignment. */
+#define MAX_SIZE 80
+
+/* Times each function this many times at each size. */
+#define ITER_CNT 100
+
+static unsigned char src_buf[4096 + 8], dst_buf[4096 + 8];
+static unsigned char ref_buf[4096 + 8];
+
+static void check_sizes (void);
+static void time_sizes (void);
+static void randomize (unsigned char *, size_t);
+static void verify (const unsigned char *, const unsigned char *, size_t);
+
+/* Test the block functions. */
+void
+test (void) 
+{
+  check_sizes ();
+  time_sizes ();
+  printf ("string: PASS\n");
+}
+
+/* Checks each function at each size up to MAX_SIZE and each
+   alignment of source and destination. */
+static void
+check_sizes (void) 
+{
+  size_t size, so, d;
+
+  printf ("testing sizes up to %d at each alignment:", MAX_SIZE);
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (so = 0; so < 4; so++)
+      for (d = 0; d < 8; d++) 
+        {
+          size_t i;
+
+          /* memcpy(). */
+          randomize (src_buf, sizeof src_buf);
+          randomize (dst_buf, sizeof dst_buf);
+          memcpy (ref_buf, dst_buf, sizeof ref_buf);
+          for (i = 0; i < size; i++)
+            ref_buf[d + i] = src_buf[so + i];
+          ASSERT (memcpy (dst_buf + d, src_buf + so, size) == dst_buf + d);
+          verify (dst_buf, ref_buf, sizeof dst_buf);
+
+          /* memcmp(), on equal blocks and then on blocks that
+             differ in one byte. */
+          ASSERT (memcmp (dst_buf + d, src_buf + so, size) == 0);
+          if (size > 0) 
+            {
+              i = random_ulong () % size;
+              dst_buf[d + i] = src_buf[so + i] + 1;
+              ASSERT (memcmp (dst_buf + d, src_buf + so, size)
+                      == (dst_buf[d + i] > src_buf[so + i] ? 1 : -1));
+            }
+
+          /* memmove(), up and then down within one buffer. */
+          memcpy (ref_buf, src_buf, sizeof ref_buf);
+          for (i = size; i-- > 0; )
+            ref_buf[so + d + i] = ref_buf[so + i];
+          ASSERT (memmove (src_buf + so + d, src_buf + so, size)
+                  == src_buf + so + d);
+          verify (src_buf, ref_buf, sizeof src_buf);
+          for (i = 0; i < size; i++)
+            ref_buf[so + i] = ref_buf[so + d + i];
+          memmove (src_buf + so, src_buf + so + d, size);
+          verify (src_buf, ref_buf, sizeof src_buf);
+
+          /* memset(). */
+          memcpy (ref_buf, dst_buf, sizeof ref_buf);
+          for (i = 0; i < size; i++)
+            ref_buf[d + i] = so * 0x55;
+          ASSERT (memset (dst_buf + d, so * 0x55, size) == dst_buf + d);
+          verify (dst_buf, ref_buf, sizeof dst_buf);
+
+          /* strlen(). */
+          for (i = 0; i < size; i++)
+            if (src_buf[so + i] == '\0')
+              src_buf[so + i] = 1;
+          src_buf[so + size] = '\0';
+          ASSERT (strlen ((char *) src_buf + so) == size);
+        }
+  printf (" done\n");
+}
+
+/* Byte-at-a-time memcpy(), for comparison. */
+static void
+byte_copy (unsigned char *dst, const unsigned char *src, size_t size) 
+{
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+/* Byte-at-a-time memset(), for comparison. */
+static void
+byte_set (unsigned char *dst, int value, size_t size) 
+{
+  while (size-- > 0)
+    *dst++ = value;
+}
+
+/* Reports the average cycles taken by memcpy(), memset() and
+   memcmp(), and by byte-at-a-time copying and setting, at sizes
+   from 16 bytes to a page. */
+static void
+time_sizes (void) 
+{
+  size_t size;
+
+  printf ("cycles per call:   size   memcpy  bytecpy   memset  byteset"
+          "   memcmp\n");
+  for (size = 16; size <= 4096; size *= 4) 
+    {
+      uint64_t start, copy, bcopy, set, bset, cmp;
+      int i;
+
+      start = rdtsc ();
+      for (i = 0; i < ITER_CNT; i++)
+        memcpy (dst_buf, src_buf, size);
+      copy = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < ITER_CNT; i++)
+        byte_copy (dst_buf, src_buf, size);
+      bcopy = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < ITER_CNT; i++)
+        memset (dst_buf, i, size);
+      set = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < ITER_CNT; i++)
+        byte_set (dst_buf, i, size);
+      bset = rdtsc () - start;
+
+      memcpy (dst_buf, src_buf, size);
+      start = rdtsc ();
+      for (i = 0; i < ITER_CNT; i++)
+        memcmp (dst_buf, src_buf, size);
+      cmp = rdtsc () - start;
+
+      printf ("                 %6zu %8"PRIu64" %8"PRIu64" %8"PRIu64
+              " %8"PRIu64" %8"PRIu64"\n",
+              size, copy / ITER_CNT, bcopy / ITER_CNT, set / ITER_CNT,
+              bset / ITER_CNT, cmp / ITER_CNT);
+    }
+}
+
+/* Fills the SIZE bytes at BUF with random values. */
+static void
+randomize (unsigned char *buf, size_t size) 
+{
+  random_bytes (buf, size);
+}
+
+/* Panics if the SIZE bytes at A and B differ. */
+static void
+verify (const unsigned char *a, const unsigned char *b, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (a[i] != b[i])
+      PANIC ("byte %zu is %02x, should be %02x", i, a[i], b[i]);
+}
@@ -0,0 +1,106 @@
+/* Arms thousands of timeouts, due at scattered times over the
+   next several seconds, plus a few dozen sleeping threads, and
+   checks that every one of them fires on exactly the tick it was
+   due.  Reports the average time taken to arm a timeout.
+
+   The time taken is reported but not checked, since it depends
+   on the simulator and the host. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timeout.h"
+#include "devices/timer.h"
+
+#define TIMEOUT_CNT 4000
+#define THREAD_CNT 32
+#define MAX_DELAY 1000
+
+/* Counts of timeouts that fired on time, and off time. */
+static int on_time, off_time;
+
+static timeout_func fire;
+static thread_func sleeper;
+
+void
+test_alarm_bench (void) 
+{
+  struct timeout *timeouts;
+  int64_t start;
+  uint64_t cycles;
+  uint32_t seed = 1;
+  int i;
+
+  timeouts = calloc (TIMEOUT_CNT, sizeof *timeouts);
+  ASSERT (timeouts != NULL);
+
+  msg ("Arming %d timeouts and %d sleeping threads "
+       "over %d ticks.", TIMEOUT_CNT, THREAD_CNT, MAX_DELAY);
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, (void *) (i * MAX_DELAY
+                                                           / THREAD_CNT));
+    }
+
+  start = timer_ticks ();
+  cycles = rdtsc ();
+  for (i = 0; i < TIMEOUT_CNT; i++) 
+    {
+      /* A simple LCG keeps the delays the same from run to run. */
+      seed = seed * 1103515245 + 12345;
+      timeout_add (&timeouts[i], start + 1 + (seed >> 8) % MAX_DELAY,
+                   fire, NULL);
+    }
+  cycles = rdtsc () - cycles;
+  printf ("(alarm-bench) %"PRIu64" cycles per timeout armed.\n",
+          cycles / TIMEOUT_CNT);
+
+  timer_sleep (MAX_DELAY + 10);
+
+  for (i = 0; i < TIMEOUT_CNT; i++)
+    if (timeouts[i].pending)
+      fail ("timeout %d due at tick %"PRId64" never fired",
+            i, timeouts[i].expires);
+  if (on_time != TIMEOUT_CNT + THREAD_CNT || off_time != 0)
+    fail ("%d timeouts fired on time, %d off time", on_time, off_time);
+  msg ("All timeouts fired on time.");
+  free (timeouts);
+}
+
+/* Called when timeout T fires. */
+static void
+fire (struct timeout *t) 
+{
+  if (t->expires == timer_ticks ())
+    on_time++;
+  else
+    off_time++;
+}
+
+/* Sleeps for the number of ticks in AUX, then checks that it did
+   not wake early.  It may run a tick late if other sleepers woke
+   at the same time, so that is not counted against it. */
+static void
+sleeper (void *ticks_) 
+{
+  int64_t ticks = (int) ticks_ + 1;
+  int64_t start = timer_ticks ();
+  enum intr_level old_level;
+
+  timer_sleep (ticks);
+
+  old_level = intr_disable ();
+  if (timer_elapsed (start) >= ticks)
+    on_time++;
+  else
+    off_time++;
+  intr_set_level (old_level);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The timing line varies from run to run, so only check that it
+# is there.
+fail "missing timing line\n"
+  if !grep (/^\(alarm-bench\) \d+ cycles per timeout armed\.$/, @output);
+@output = grep (!/^\(alarm-bench\) \d+ cycles per timeout armed\.$/,
+		@output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-bench) begin
+(alarm-bench) Arming 4000 timeouts and 32 sleeping threads over 1000 ticks.
+(alarm-bench) All timeouts fired on time.
+(alarm-bench) end
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Checks that timer_usleep() sleeps for less than a timer tick
+   without busy-waiting, and that threads sleeping for different
+   sub-tick intervals wake up in order of their deadlines. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5
+
+static thread_func usleep_thread;
+
+/* Number of threads that have woken up. */
+static volatile int wake_cnt;
+
+void
+test_alarm_usleep (void) 
+{
+  long long spins = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* The sleepers preempt us as they are created, then sleep for
+     1.5 to 7.5 ms, all within a few timer ticks.  If they
+     busy-waited, each would finish before the next was
+     created, and we would never get to spin. */
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "usleep %d", i);
+      thread_create (name, PRI_DEFAULT + 1, usleep_thread, (void *) i);
+    }
+
+  while (wake_cnt < THREAD_CNT)
+    spins++;
+
+  if (spins == 0)
+    fail ("main thread never ran while the sleepers slept");
+  msg ("Main thread ran while the sleepers slept.");
+}
+
+static void
+usleep_thread (void *i_) 
+{
+  int i = (int) i_;
+
+  timer_usleep ((THREAD_CNT - i) * 1500);
+  msg ("Thread %d woke up.", i);
+  wake_cnt++;
+}
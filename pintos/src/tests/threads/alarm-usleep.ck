@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) Thread 4 woke up.
+(alarm-usleep) Thread 3 woke up.
+(alarm-usleep) Thread 2 woke up.
+(alarm-usleep) Thread 1 woke up.
+(alarm-usleep) Thread 0 woke up.
+(alarm-usleep) Main thread ran while the sleepers slept.
+(alarm-usleep) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Acquires and releases a lock many times while other threads
+   of the same priority are ready to run, and counts the context
+   switches that result.  (The threads kernel has no buffer
+   cache; filesys/base/syn-read-switch measures the same thing
+   for the cache's lock under real contention.)  Releasing a lock
+   that no higher-priority thread is waiting for should not
+   switch threads at all, so only the occasional end of a time
+   slice should show up in the count.
+
+   Also checks that releasing a lock still hands the CPU straight
+   to a higher-priority waiter.
+
+   The switch count is reported but only loosely checked, since
+   timer interrupts may land anywhere in the loop. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define LOCK_CNT 1000
+
+static struct lock lock;
+static volatile bool done;
+static volatile bool waiter_ran;
+
+static thread_func spin_thread;
+static thread_func waiter_thread;
+
+void
+test_lock_bench (void) 
+{
+  long long switches;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "spin %d", i);
+      thread_create (name, PRI_DEFAULT, spin_thread, NULL);
+    }
+  msg ("%d threads ready at our priority.", THREAD_CNT);
+
+  switches = thread_switch_count ();
+  for (i = 0; i < LOCK_CNT; i++) 
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+  switches = thread_switch_count () - switches;
+  printf ("(lock-bench) %lld context switches in %d lock releases.\n",
+          switches, LOCK_CNT);
+  if (switches >= LOCK_CNT / 10)
+    fail ("uncontended lock releases switched threads %lld times",
+          switches);
+
+  lock_acquire (&lock);
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter_thread, NULL);
+  lock_release (&lock);
+  if (!waiter_ran)
+    fail ("higher-priority waiter did not run on release");
+  msg ("Higher-priority waiter ran on release.");
+
+  done = true;
+}
+
+/* Yields until the test is done. */
+static void
+spin_thread (void *aux UNUSED) 
+{
+  while (!done)
+    thread_yield ();
+}
+
+/* Waits for the lock, which the main thread holds. */
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  waiter_ran = true;
+  lock_release (&lock);
+}
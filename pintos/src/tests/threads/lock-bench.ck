@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The switch count varies from run to run, so only check that it
+# is there.
+my ($switches) = qr/^\(lock-bench\) \d+ context switches in \d+ lock releases\.$/;
+fail "missing switch count\n" if !grep (/$switches/, @output);
+@output = grep (!/$switches/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(lock-bench) begin
+(lock-bench) 4 threads ready at our priority.
+(lock-bench) Higher-priority waiter ran on release.
+(lock-bench) end
+EOF
+pass;
@@ -0,0 +1,96 @@
+/* Allocates runs of user pool pages of random sizes until half
+   the pool is in use, then frees every other run and reports how
+   fragmented the free memory is, as the largest free block
+   against the number of free pages.  Frees the rest and checks
+   that the pool merges back into the blocks it started with.
+   Also reports the average time taken to allocate and free a
+   page and an 8-page run.
+
+   The fragmentation and times are reported but not checked,
+   since they depend on the random sizes, the simulator and the
+   host. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/tsc.h"
+
+#define RUN_MAX 512             /* Maximum number of runs. */
+#define RUN_PAGES 8             /* Maximum pages in a run. */
+#define ITER_CNT 1000           /* Iterations timed. */
+
+static void *runs[RUN_MAX];
+static size_t run_pages[RUN_MAX];
+
+static void time_alloc (size_t page_cnt);
+
+void
+test_palloc_bench (void) 
+{
+  size_t start_free, start_largest;
+  size_t free_cnt, largest;
+  size_t used = 0;
+  int run_cnt, i;
+
+  start_free = palloc_free_cnt (PAL_USER, &start_largest);
+  if (start_free == 0)
+    fail ("user pool is empty");
+
+  random_init (0);
+  for (run_cnt = 0; run_cnt < RUN_MAX && used < start_free / 2; run_cnt++) 
+    {
+      run_pages[run_cnt] = random_ulong () % RUN_PAGES + 1;
+      runs[run_cnt] = palloc_get_multiple (PAL_USER, run_pages[run_cnt]);
+      if (runs[run_cnt] == NULL)
+        fail ("allocating run %d of %zu pages failed",
+              run_cnt, run_pages[run_cnt]);
+      used += run_pages[run_cnt];
+    }
+  msg ("Allocated half the user pool.");
+
+  for (i = 0; i < run_cnt; i += 2)
+    palloc_free_multiple (runs[i], run_pages[i]);
+  free_cnt = palloc_free_cnt (PAL_USER, &largest);
+  printf ("(palloc-bench) After freeing every other run, largest free "
+          "block is %zu of %zu free pages.\n", largest, free_cnt);
+
+  for (i = 1; i < run_cnt; i += 2)
+    palloc_free_multiple (runs[i], run_pages[i]);
+  free_cnt = palloc_free_cnt (PAL_USER, &largest);
+  /* An allocation that found no block big enough may have given
+     the idle thread's zeroed pages back to the free lists, so the
+     largest block can come out bigger than it started, but never
+     smaller. */
+  if (free_cnt != start_free || largest < start_largest)
+    fail ("pool has %zu free pages, largest block %zu, "
+          "but started with %zu, largest block %zu",
+          free_cnt, largest, start_free, start_largest);
+  msg ("Freed all runs; free blocks merged back together.");
+
+  time_alloc (1);
+  time_alloc (RUN_PAGES);
+}
+
+/* Allocates and frees PAGE_CNT user pool pages ITER_CNT times
+   and reports the average time taken. */
+static void
+time_alloc (size_t page_cnt) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      void *pages = palloc_get_multiple (PAL_USER, page_cnt);
+      if (pages == NULL)
+        fail ("allocating %zu pages failed", page_cnt);
+      palloc_free_multiple (pages, page_cnt);
+    }
+  cycles = rdtsc () - start;
+  printf ("(palloc-bench) %"PRIu64" cycles to allocate and free "
+          "%zu pages.\n", cycles / ITER_CNT, page_cnt);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Fragmentation and times vary, so only check that they are there.
+my ($frag) = qr/^\(palloc-bench\) After freeing every other run, largest free block is \d+ of \d+ free pages\.$/;
+my ($time) = qr/^\(palloc-bench\) \d+ cycles to allocate and free \d+ pages\.$/;
+fail "missing fragmentation report\n" if !grep (/$frag/, @output);
+fail "missing times\n" if grep (/$time/, @output) != 2;
+@output = grep (!/$frag/ && !/$time/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(palloc-bench) begin
+(palloc-bench) Allocated half the user pool.
+(palloc-bench) Freed all runs; free blocks merged back together.
+(palloc-bench) end
+EOF
+pass;
@@ -0,0 +1,88 @@
+/* Puts a few hundred threads, spread over many priorities, on
+   the run queues at once and has each of them yield repeatedly,
+   timing how long the whole batch takes to run to completion.
+   Also checks that the threads finish in order of decreasing
+   priority, which they must if the scheduler always picks the
+   highest-priority ready thread.
+
+   The time taken is reported but not checked, since it depends
+   on the simulator and the host. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 200
+#define YIELD_CNT 50
+
+/* Priorities of the threads, in the order they finished. */
+static int *finished;
+static int finished_cnt;
+
+static thread_func yield_thread;
+
+void
+test_sched_bench (void) 
+{
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  finished = malloc (sizeof *finished * THREAD_CNT);
+  ASSERT (finished != NULL);
+  finished_cnt = 0;
+
+  /* Create the threads at priorities below our own, so that none
+     of them runs until we drop our priority below all of them. */
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      int priority = PRI_MIN + 1 + i % (PRI_DEFAULT - PRI_MIN - 1);
+      char name[16];
+
+      snprintf (name, sizeof name, "yield %d", i);
+      if (thread_create (name, priority, yield_thread, NULL) == TID_ERROR)
+        fail ("creating thread %d failed", i);
+    }
+  msg ("%d threads ready at %d priorities, %d yields each.",
+       THREAD_CNT, PRI_DEFAULT - PRI_MIN - 1, YIELD_CNT);
+
+  /* All the other threads now run to termination here. */
+  start = timer_ticks ();
+  thread_set_priority (PRI_MIN);
+  printf ("(sched-bench) %d yields in %"PRId64" ticks.\n",
+          THREAD_CNT * YIELD_CNT, timer_elapsed (start));
+  thread_set_priority (PRI_DEFAULT);
+
+  if (finished_cnt != THREAD_CNT)
+    fail ("only %d of %d threads finished", finished_cnt, THREAD_CNT);
+  for (i = 1; i < THREAD_CNT; i++)
+    if (finished[i] > finished[i - 1])
+      fail ("thread at priority %d finished after one at priority %d",
+            finished[i], finished[i - 1]);
+  msg ("Threads finished in priority order.");
+  free (finished);
+}
+
+static void 
+yield_thread (void *aux UNUSED) 
+{
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+
+  old_level = intr_disable ();
+  finished[finished_cnt++] = thread_get_priority ();
+  intr_set_level (old_level);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The timing line varies from run to run, so only check that it
+# is there.
+fail "missing timing line\n"
+  if !grep (/^\(sched-bench\) \d+ yields in \d+ ticks\.$/, @output);
+@output = grep (!/^\(sched-bench\) \d+ yields in \d+ ticks\.$/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(sched-bench) begin
+(sched-bench) 200 threads ready at 30 priorities, 50 yields each.
+(sched-bench) Threads finished in priority order.
+(sched-bench) end
+EOF
+pass;
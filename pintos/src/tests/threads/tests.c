@@ -38,6 +38,11 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"sched-bench", test_sched_bench},
+    {"alarm-bench", test_alarm_bench},
+    {"alarm-usleep", test_alarm_usleep},
+    {"lock-bench", test_lock_bench},
+    {"palloc-bench", test_palloc_bench},
   };
 
 static const char *test_name;
@@ -0,0 +1,30 @@
+/* Opens the same file 300 times, more descriptors than a process
+   could once hold, then closes one in the middle and opens the
+   file again, which must reuse the lowest free descriptor. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 300
+
+void
+test_main (void) 
+{
+  int handles[OPEN_CNT];
+  int i;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, handles[i], handles[i - 1]);
+    }
+  msg ("opened \"sample.txt\" %d times", OPEN_CNT);
+
+  close (handles[100]);
+  close (handles[200]);
+  CHECK (open ("sample.txt") == handles[100], "reopen reuses lowest free fd");
+}
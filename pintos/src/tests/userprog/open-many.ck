@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened "sample.txt" 300 times
+(open-many) reopen reuses lowest free fd
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
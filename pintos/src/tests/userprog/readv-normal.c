@@ -0,0 +1,29 @@
+/* Read a file with readv() into two buffers and verify that the
+   first is filled completely before the second. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char head[100], tail[sizeof sample];
+  struct iovec iov[2];
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = tail;
+  iov[1].iov_len = sizeof tail;
+  byte_cnt = readv (handle, iov, 2);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (head, sample, sizeof head)
+      || memcmp (tail, sample + sizeof head, byte_cnt - sizeof head))
+    fail ("readv() data does not match sample");
+}
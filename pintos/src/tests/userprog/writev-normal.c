@@ -0,0 +1,31 @@
+/* Write a file with writev() from several buffers, one of them
+   empty, and verify that the segments were written back to
+   back. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = sample + 100;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 100;
+  iov[2].iov_len = sizeof sample - 1 - 100;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("writev() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
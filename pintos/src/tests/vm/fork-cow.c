@@ -0,0 +1,33 @@
+/* Forks a child that overwrites half of a buffer it shares
+   copy-on-write with its parent.  The child must see its own
+   writes and the untouched half, and the parent must still see
+   the original contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096 * 4];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'p', sizeof buf);
+  child = fork ();
+  if (child == 0)
+    {
+      memset (buf, 'c', sizeof buf / 2);
+      exit (buf[0] == 'c' && buf[sizeof buf - 1] == 'p' ? 81 : 1);
+    }
+  if (child == PID_ERROR)
+    fail ("fork");
+
+  CHECK (wait (child) == 81, "wait for child");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 'p')
+      fail ("parent's buffer changed at byte %zu", i);
+}
@@ -0,0 +1,48 @@
+/* Reads a file into, and writes it from, buffers that span
+   several pages, none of which have been touched yet, so that
+   the system call must fault in each page while keeping the
+   pages before it pinned. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4096 * 3)
+
+static char src[SIZE] __attribute__ ((aligned (4096)));
+static char dst[SIZE + 4096] __attribute__ ((aligned (4096)));
+static char zeros[SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    src[i] = i % 251 + 1;
+
+  CHECK (create ("span", SIZE), "create \"span\"");
+  CHECK ((handle = open ("span")) > 1, "open \"span\"");
+  CHECK (write (handle, src, SIZE) == SIZE, "write \"span\"");
+
+  /* Read into the middle of an untouched buffer, so that the
+     read spans four pages. */
+  seek (handle, 0);
+  CHECK (read (handle, dst + 100, SIZE) == SIZE,
+         "read \"span\" into untouched buffer");
+  CHECK (!memcmp (src, dst + 100, SIZE), "compare read data");
+
+  /* Write from an untouched buffer. */
+  seek (handle, 0);
+  CHECK (write (handle, zeros, SIZE) == SIZE,
+         "write \"span\" from untouched buffer");
+  seek (handle, 0);
+  CHECK (read (handle, src, SIZE) == SIZE, "read \"span\" again");
+  for (i = 0; i < SIZE; i++)
+    if (src[i] != 0)
+      fail ("byte %zu is %d, not 0", i, src[i]);
+  msg ("compare written zeros");
+  close (handle);
+}
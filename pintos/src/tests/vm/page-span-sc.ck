@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-span-sc) begin
+(page-span-sc) create "span"
+(page-span-sc) open "span"
+(page-span-sc) write "span"
+(page-span-sc) read "span" into untouched buffer
+(page-span-sc) compare read data
+(page-span-sc) write "span" from untouched buffer
+(page-span-sc) read "span" again
+(page-span-sc) compare written zeros
+(page-span-sc) end
+EOF
+pass;
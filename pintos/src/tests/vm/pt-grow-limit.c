@@ -0,0 +1,18 @@
+/* Move the stack pointer 16 MB below the top of user memory,
+   beyond the default 8 MB stack limit, and push onto it.
+   The process must be terminated with -1 exit code. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  asm volatile
+    ("movl %%esp, %%eax;"        /* Save a copy of the stack pointer. */
+     "movl $0xbf000000, %%esp;"  /* Move stack pointer 16 MB down. */
+     "pushl $0;"                 /* Push, which must not grow the stack. */
+     "movl %%eax, %%esp"         /* Restore copied stack pointer. */
+     : : : "eax");               /* Tell GCC we destroyed eax. */
+  fail ("should have exited with -1");
+}
@@ -354,6 +354,9 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* Restart the timer tick if the CPU was idle. */
+      timer_irq_enter (frame->vec_no);
     }
 
   /* Invoke the interrupt's handler. */
@@ -41,6 +41,8 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    struct lock_stats lock_stats; /* Contention on LOCK. */
+    char name[16];              /* Name of LOCK, e.g. "malloc 16". */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -81,6 +83,8 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+      lock_profile (&d->lock, &d->lock_stats, d->name);
     }
 }
 
@@ -2,11 +2,13 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,14 +25,60 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, each aligned (relative to
+   the pool base) to its own size, on one free list per order.
+   A request for N pages takes the smallest free block of at
+   least N pages, splitting larger blocks in half as needed, and
+   gives back the unused tail.  A freed block is merged with its
+   "buddy", the other half of the block it was split from,
+   whenever that is free too.  Both take O(log n) time in the
+   size of the pool, where scanning a bitmap took O(n), and
+   merging keeps large runs available for malloc()'s big blocks.
+
+   A free block's list element lives in its own first page, and
+   the pool's order map records, for each page, the order of the
+   free block starting there, if any.
+
+   The idle thread also takes single pages out of each pool and
+   zeroes them, up to ZEROED_MAX per pool, so that most PAL_ZERO
+   requests for a page, such as for page tables, thread stacks
+   and user stack pages, need not clear one themselves.  The idle
+   thread must never block, so it cannot wait for a pool's lock;
+   instead, the list of zeroed pages is protected by disabling
+   interrupts.  Zeroed pages are handed back to the buddy system
+   when a request cannot otherwise be met. */
+
+/* Largest block order, enough for a 4 GB pool. */
+#define MAX_ORDER 20
+
+/* Order map entry for a page that does not start a free block. */
+#define NOT_FREE UINT8_MAX
+
+/* Most pages to keep zeroed in each pool. */
+#define ZEROED_MAX 64
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
+    struct lock_stats lock_stats;       /* Contention on LOCK. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *order_map;                 /* Order of free block at each page. */
+    struct list free[MAX_ORDER + 1];    /* Free blocks of each order. */
+    size_t free_cnt;                    /* Number of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    const char *name;                   /* Name, for palloc_print_stats(). */
+    unsigned long long zero_misses;     /* PAL_ZERO requests that missed. */
+
+    /* Pages zeroed by the idle thread.  Interrupts must be
+       disabled to access these members. */
+    struct list zeroed;                 /* Zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+    unsigned long long idle_zeroed;     /* Pages zeroed by idle thread. */
+    unsigned long long zero_hits;       /* PAL_ZERO pages from ZEROED. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +87,11 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, unsigned order);
+static void *take_zeroed (struct pool *);
+static bool release_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -77,8 +130,19 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
+  if (flags & PAL_ZERO && page_cnt == 1) 
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = alloc_pages (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && release_zeroed (pool))
+    page_idx = alloc_pages (pool, page_cnt);
+  if (flags & PAL_ZERO)
+    pool->zero_misses++;
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -137,8 +201,9 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  lock_acquire (&pool->lock);
+  free_pages (pool, page_idx, page_cnt);
+  lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +213,101 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool, if PAL_USER
+   is set in FLAGS, or the kernel pool otherwise.  If LARGEST is
+   non-null, stores the size of the pool's largest free block,
+   in pages, into *LARGEST. */
+size_t
+palloc_free_cnt (enum palloc_flags flags, size_t *largest) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t free_cnt;
+  int order;
+
+  lock_acquire (&pool->lock);
+  free_cnt = pool->free_cnt + pool->zeroed_cnt;
+  if (largest != NULL) 
+    {
+      for (order = MAX_ORDER; order >= 0; order--)
+        if (!list_empty (&pool->free[order]))
+          break;
+      *largest = order >= 0 ? (size_t) 1 << order : 0;
+    }
+  lock_release (&pool->lock);
+
+  return free_cnt;
+}
+
+/* Zeroes a free page, if a pool is short of zeroed pages, and
+   returns true if it did.  Called by the idle thread, with
+   interrupts off, whenever there is nothing else to run.
+   Interrupts are turned back on while the page is cleared, so
+   this may be preempted. */
+bool
+palloc_zero_idle (void) 
+{
+  struct pool *pool;
+  size_t page_idx;
+  uint8_t *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (kernel_pool.zeroed_cnt < ZEROED_MAX && kernel_pool.free_cnt > 0)
+    pool = &kernel_pool;
+  else if (user_pool.zeroed_cnt < ZEROED_MAX && user_pool.free_cnt > 0)
+    pool = &user_pool;
+  else
+    return false;
+
+  /* With interrupts off, no one can be waiting for the lock, so
+     taking and releasing it cannot block or donate. */
+  if (!lock_try_acquire (&pool->lock))
+    return false;
+  page_idx = alloc_pages (pool, 1);
+  lock_release (&pool->lock);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  intr_enable ();
+  memset (page, 0, PGSIZE);
+  intr_disable ();
+
+  list_push_front (&pool->zeroed, (struct list_elem *) page);
+  pool->zeroed_cnt++;
+  pool->idle_zeroed++;
+  return true;
+}
+
+/* Prints statistics on pages zeroed by the idle thread. */
+void
+palloc_print_stats (void) 
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++) 
+    {
+      struct pool *p = pools[i];
+      printf ("Palloc: %s: %llu pages zeroed while idle, "
+              "%llu zeroed page hits, %llu misses\n",
+              p->name, p->idle_zeroed, p->zero_hits, p->zero_misses);
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and order_map at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size.  This overestimates a little, since the
+     maps only need to cover the pages that remain. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  unsigned order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,8 +316,22 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  lock_profile (&p->lock, &p->lock_stats, name);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->order_map = (uint8_t *) base + bm_size;
+  memset (p->order_map, NOT_FREE, page_cnt);
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free[order]);
+  p->free_cnt = 0;
   p->base = base + bm_pages * PGSIZE;
+  p->name = name;
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->idle_zeroed = p->zero_hits = p->zero_misses = 0;
+
+  /* Every page is allocated so far.  Free them all. */
+  bitmap_set_all (p->used_map, true);
+  free_pages (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +345,159 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list element kept in the first page of the free
+   block at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the page index of the free block whose list element
+   is E, in POOL. */
+static size_t
+elem_block (const struct pool *pool, struct list_elem *e) 
+{
+  return ((uint8_t *) e - pool->base) / PGSIZE;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if there is no free
+   block large enough.  POOL's lock must be held. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) 
+{
+  unsigned want, order;
+  size_t page_idx;
+
+  /* Find the smallest free block that is big enough. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == MAX_ORDER)
+      return BITMAP_ERROR;
+  for (order = want; order <= MAX_ORDER; order++)
+    if (!list_empty (&pool->free[order]))
+      break;
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  page_idx = elem_block (pool, list_pop_front (&pool->free[order]));
+  ASSERT (pool->order_map[page_idx] == order);
+  pool->order_map[page_idx] = NOT_FREE;
+  pool->free_cnt -= (size_t) 1 << order;
+
+  /* Split it down to the size we want, freeing the upper halves,
+     then give back the pages past PAGE_CNT. */
+  while (order > want) 
+    {
+      order--;
+      free_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  ASSERT (!bitmap_any (pool->used_map, page_idx, (size_t) 1 << want));
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << want, true);
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that make up the run.  POOL's lock must
+   be held. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+
+  while (page_cnt > 0) 
+    {
+      unsigned order = 0;
+
+      while (order < MAX_ORDER
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX to POOL's free
+   lists, first merging it with its buddy for as long as the
+   buddy is free.  POOL's lock must be held. */
+static void
+free_block (struct pool *pool, size_t page_idx, unsigned order) 
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  pool->free_cnt += (size_t) 1 << order;
+  while (order < MAX_ORDER) 
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > page_cnt
+          || pool->order_map[buddy_idx] != order)
+        break;
+
+      list_remove (block_elem (pool, buddy_idx));
+      pool->order_map[buddy_idx] = NOT_FREE;
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+
+  pool->order_map[page_idx] = order;
+  list_push_front (&pool->free[order], block_elem (pool, page_idx));
+}
+
+/* Takes a page from POOL's zeroed pages and returns it, or
+   returns a null pointer if there are none. */
+static void *
+take_zeroed (struct pool *pool) 
+{
+  struct list_elem *e = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&pool->zeroed)) 
+    {
+      e = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+      pool->zero_hits++;
+    }
+  intr_set_level (old_level);
+
+  /* The list element was the only part of the page not zero. */
+  if (e != NULL)
+    memset (e, 0, sizeof *e);
+  return e;
+}
+
+/* Returns all of POOL's zeroed pages to its free lists.  Returns
+   true if there were any.  POOL's lock must be held. */
+static bool
+release_zeroed (struct pool *pool) 
+{
+  bool released = false;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  for (;;) 
+    {
+      struct list_elem *e = NULL;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      if (!list_empty (&pool->zeroed)) 
+        {
+          e = list_pop_front (&pool->zeroed);
+          pool->zeroed_cnt--;
+        }
+      intr_set_level (old_level);
+
+      if (e == NULL)
+        return released;
+      free_pages (pool, elem_block (pool, e), 1);
+      released = true;
+    }
+}
@@ -0,0 +1,219 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator.
+
+   malloc() rounds each request up to a power of 2, and serves
+   requests over 1 kB with whole pages, so objects just over a
+   power of 2 waste nearly half their memory, and an object of a
+   little over 1 kB wastes most of a page.  A slab cache instead
+   serves objects of one exact size: it carves pages, called
+   "slabs", into as many objects as fit, and keeps a list of
+   slabs that have free objects.
+
+   Each slab starts with a header, followed by a stack of the
+   indexes of its free objects, followed by the objects
+   themselves.  Keeping the free list outside the objects means
+   that a free object retains the state its constructor gave it,
+   so the constructor runs only once per object, when its slab
+   is created, rather than on every allocation.  Objects must be
+   returned to that state before they are freed.
+
+   A slab that becomes entirely free is returned to the page
+   allocator, unless it would leave the cache with less than a
+   slab's worth of free objects, so that a cache whose usage
+   hovers around a slab boundary does not keep creating and
+   destroying slabs. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab 
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's slabs list. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint8_t free[];             /* Stack of free object indexes. */
+  };
+
+/* Largest number of objects in a slab, limited by the size of
+   the entries in the free stack. */
+#define MAX_OBJS_PER_SLAB UINT8_MAX
+
+/* List of all slab caches. */
+static struct list cache_list = LIST_INITIALIZER (cache_list);
+
+static struct slab *slab_create (struct slab_cache *);
+static void *slab_object (struct slab *, size_t idx);
+
+/* Initializes CACHE to allocate objects SIZE bytes in size,
+   calling CTOR, if non-null, to construct each object when it is
+   first created.  CTOR runs with CACHE's lock held, so it must
+   not allocate from CACHE.  NAME is not copied. */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size,
+                 slab_ctor *ctor) 
+{
+  size_t n;
+
+  ASSERT (cache != NULL);
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  cache->name = name;
+  cache->obj_size = ROUND_UP (size, sizeof (uint32_t));
+  cache->ctor = ctor;
+  list_init (&cache->slabs);
+  lock_init (&cache->lock);
+  lock_profile (&cache->lock, &cache->lock_stats, name);
+  cache->slab_cnt = cache->in_use = 0;
+  cache->alloc_cnt = 0;
+
+  /* Fit as many objects as we can, each with its entry in the
+     free stack, after the header, then back off until the
+     objects, aligned, still fit. */
+  n = (PGSIZE - sizeof (struct slab)) / (cache->obj_size + 1);
+  if (n > MAX_OBJS_PER_SLAB)
+    n = MAX_OBJS_PER_SLAB;
+  while (n > 0
+         && ROUND_UP (sizeof (struct slab) + n, sizeof (uint32_t))
+            + n * cache->obj_size > PGSIZE)
+    n--;
+  ASSERT (n > 0);
+  cache->objs_per_slab = n;
+  cache->objs_ofs = ROUND_UP (sizeof (struct slab) + n, sizeof (uint32_t));
+
+  list_push_back (&cache_list, &cache->elem);
+}
+
+/* Allocates and returns an object from CACHE, in the state its
+   constructor left it or in which it was last freed.  Returns a
+   null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *cache) 
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (cache != NULL);
+
+  lock_acquire (&cache->lock);
+  if (list_empty (&cache->slabs)) 
+    {
+      s = slab_create (cache);
+      if (s == NULL) 
+        {
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      list_push_front (&cache->slabs, &s->elem);
+    }
+  else
+    s = list_entry (list_front (&cache->slabs), struct slab, elem);
+
+  obj = slab_object (s, s->free[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+  cache->in_use++;
+  cache->alloc_cnt++;
+  lock_release (&cache->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from CACHE, to
+   CACHE.  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *cache, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  ASSERT (cache != NULL);
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == cache);
+  idx = ((uint8_t *) obj - (uint8_t *) s - cache->objs_ofs)
+        / cache->obj_size;
+  ASSERT (slab_object (s, idx) == obj);
+
+  lock_acquire (&cache->lock);
+  ASSERT (s->free_cnt < cache->objs_per_slab);
+  s->free[s->free_cnt++] = idx;
+  cache->in_use--;
+  if (s->free_cnt == 1)
+    list_push_front (&cache->slabs, &s->elem);
+  else if (s->free_cnt == cache->objs_per_slab
+           && (cache->slab_cnt - 1) * cache->objs_per_slab - cache->in_use
+              >= cache->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      cache->slab_cnt--;
+      s->magic = 0;
+      palloc_free_page (s);
+    }
+  lock_release (&cache->lock);
+}
+
+/* Prints statistics for each slab cache. */
+void
+slab_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e)) 
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+      printf ("Slab: %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use, %lu allocations\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->in_use, c->alloc_cnt);
+    }
+}
+
+/* Creates a new slab for CACHE, with all its objects free and
+   constructed.  Returns a null pointer if memory is not
+   available.  CACHE's lock must be held. */
+static struct slab *
+slab_create (struct slab_cache *cache) 
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->free_cnt = cache->objs_per_slab;
+  for (i = 0; i < cache->objs_per_slab; i++) 
+    {
+      s->free[i] = i;
+      if (cache->ctor != NULL)
+        cache->ctor (slab_object (s, i));
+    }
+  cache->slab_cnt++;
+  return s;
+}
+
+/* Returns object IDX within slab S. */
+static void *
+slab_object (struct slab *s, size_t idx) 
+{
+  ASSERT (idx < s->cache->objs_per_slab);
+  return (uint8_t *) s + s->cache->objs_ofs + idx * s->cache->obj_size;
+}
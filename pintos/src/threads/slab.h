@@ -0,0 +1,36 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Constructs object OBJ in a slab cache. */
+typedef void slab_ctor (void *obj);
+
+/* A cache of objects of a single type. */
+struct slab_cache 
+  {
+    const char *name;           /* Name, for slab_print_stats(). */
+    size_t obj_size;            /* Size of each object, in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t objs_ofs;            /* Offset of first object in a slab. */
+    slab_ctor *ctor;            /* Constructor, or null. */
+    struct list slabs;          /* Slabs with free objects. */
+    struct lock lock;           /* Protects the slabs. */
+    struct lock_stats lock_stats; /* Contention on LOCK. */
+    struct list_elem elem;      /* Element in list of all caches. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs, i.e. pages, held. */
+    size_t in_use;              /* Objects allocated and not freed. */
+    unsigned long alloc_cnt;    /* Allocations. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      slab_ctor *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -27,10 +27,21 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* If true, locks and semaphores given names with lock_profile()
+   and sema_profile() keep contention statistics.
+   Controlled by kernel command-line option "-lockstat". */
+bool lock_profiling;
+
+/* List of profiled locks and semaphores, in order of
+   registration. */
+static struct list profiled_list = LIST_INITIALIZER (profiled_list);
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,6 +58,7 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->stats = NULL;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -60,17 +72,29 @@ void
 sema_down (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  uint64_t wait_start = 0;
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  if (sema->stats != NULL) 
+    {
+      sema->stats->acquire_cnt++;
+      if (sema->value == 0) 
+        {
+          sema->stats->contended_cnt++;
+          wait_start = rdtsc ();
+        }
+    }
   while (sema->value == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
       thread_block ();
     }
   sema->value--;
+  if (wait_start != 0)
+    sema->stats->wait_cycles += rdtsc () - wait_start;
   intr_set_level (old_level);
 }
 
@@ -122,13 +146,9 @@ sema_up (struct semaphore *sema)
     any_unblock = true;
   }
   sema->value++;
+  if (any_unblock)
+    thread_yield_to_higher ();
   intr_set_level (old_level);
-  if (any_unblock){
-    if (intr_context())
-      intr_yield_on_return();
-    else
-      thread_yield();
-  }
 }
 
 static void sema_test_helper (void *sema_);
@@ -219,6 +239,8 @@ lock_acquire (struct lock *lock)
   sema_down (&lock->semaphore);
   current_t->locked_by = NULL;
   lock->holder = current_t;
+  if (lock->semaphore.stats != NULL)
+    lock->semaphore.stats->acquired_at = rdtsc ();
   list_push_back(&current_t->lock_list, &lock->elem); 
   intr_set_level (old_level);
 }
@@ -240,6 +262,11 @@ lock_try_acquire (struct lock *lock)
   success = sema_try_down (&lock->semaphore);
   if (success){
     lock->holder = thread_current ();
+    if (lock->semaphore.stats != NULL) 
+      {
+        lock->semaphore.stats->acquire_cnt++;
+        lock->semaphore.stats->acquired_at = rdtsc ();
+      }
     list_push_back(&thread_current ()->lock_list, &lock->elem);
   }
   return success;
@@ -261,6 +288,13 @@ lock_release (struct lock *lock)
 
   old_level = intr_disable ();
   current_t = thread_current();
+  if (lock->semaphore.stats != NULL) 
+    {
+      struct lock_stats *stats = lock->semaphore.stats;
+      uint64_t held = rdtsc () - stats->acquired_at;
+      if (held > stats->max_hold_cycles)
+        stats->max_hold_cycles = held;
+    }
   /* Lower priority */
   if (!is_thread_mlfqs())
     current_t->priority = current_t->orig_priority;
@@ -273,8 +307,12 @@ lock_release (struct lock *lock)
   if (current_t->priority < alt_priority && !is_thread_mlfqs())
     current_t->priority = alt_priority;
   lock->holder = NULL;
+
+  /* sema_up() yields if the waiter it wakes outranks us.  Check
+     again in case dropping a donated priority let a thread that
+     was already ready outrank us. */
   sema_up (&lock->semaphore);
-  thread_yield();
+  thread_yield_to_higher ();
   intr_set_level (old_level);
 }
 
@@ -370,7 +408,6 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
     sema_up (&list_entry (max_priority,
                           struct semaphore_elem, elem)->semaphore);
   }
-  thread_yield();
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -389,6 +426,259 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
+/* Initializes RW as an unlocked reader/writer lock.  Any number
+   of readers may hold RW at once, or a single writer.
+
+   Writers take precedence: once a writer arrives, readers that
+   come after it wait until it is done, so a steady stream of
+   readers cannot starve writers.  This works by having the
+   writer hold RW's internal lock from the time it arrives until
+   it is done, and having each reader briefly take the same lock
+   on the way in.  Threads waiting behind a writer, whether
+   readers or writers, thus donate their priority to it in the
+   usual way.  A writer waiting for the readers already inside to
+   leave does not donate to them, since a lock has only one
+   holder to donate to. */
+void
+rwlock_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->write_lock);
+  sema_init (&rw->drained, 0);
+  rw->reader_cnt = 0;
+  rw->draining = false;
+  rw->read_cnt = rw->write_cnt = 0;
+  rw->read_waits = rw->write_waits = 0;
+}
+
+/* Acquires RW for reading, sleeping until any writer that holds
+   it or is waiting for it is done.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  rw->read_cnt++;
+  if (rw->write_lock.holder != NULL)
+    rw->read_waits++;
+  lock_acquire (&rw->write_lock);
+  rw->reader_cnt++;
+  lock_release (&rw->write_lock);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_read_release (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->reader_cnt > 0);
+  if (--rw->reader_cnt == 0 && rw->draining) 
+    {
+      rw->draining = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until any other writer is
+   done and then until the readers inside have left.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  rw->write_cnt++;
+  if (rw->write_lock.holder != NULL || rw->reader_cnt > 0)
+    rw->write_waits++;
+  lock_acquire (&rw->write_lock);
+
+  old_level = intr_disable ();
+  if (rw->reader_cnt > 0) 
+    {
+      rw->draining = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rwlock_write_release (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw->reader_cnt == 0);
+
+  lock_release (&rw->write_lock);
+}
+
+/* Initializes SEQ as a sequence lock.
+
+   A sequence lock protects small amounts of data that are read
+   often and written rarely.  Writers exclude each other, but
+   never wait for readers.  Readers take no lock at all: they
+   note the sequence number before reading and retry if a write
+   began or ended meanwhile, like this:
+
+     do 
+       {
+         seq = seqlock_read_begin (&x->seq);
+         ...copy out the protected data...
+       }
+     while (seqlock_read_retry (&x->seq, seq));
+
+   Readers must not act on what they read until the loop exits. */
+void
+seqlock_init (struct seqlock *seq) 
+{
+  ASSERT (seq != NULL);
+
+  seq->seq = 0;
+  lock_init (&seq->write_lock);
+  seq->write_cnt = seq->retry_cnt = 0;
+}
+
+/* Begins a read of data protected by SEQ and returns the
+   sequence number to pass to seqlock_read_retry().  If a write
+   is in progress, waits for it to finish first: on a single CPU
+   the writer cannot make progress while we spin, so we acquire
+   the writer's lock instead, donating our priority to it. */
+unsigned
+seqlock_read_begin (struct seqlock *seq) 
+{
+  unsigned s;
+
+  ASSERT (seq != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (&seq->write_lock));
+
+  for (;;) 
+    {
+      s = seq->seq;
+      barrier ();
+      if (s % 2 == 0)
+        return s;
+
+      lock_acquire (&seq->write_lock);
+      lock_release (&seq->write_lock);
+    }
+}
+
+/* Returns true if the data read since seqlock_read_begin()
+   returned SEQ may be inconsistent, so that the read must be
+   retried. */
+bool
+seqlock_read_retry (struct seqlock *seq, unsigned s) 
+{
+  ASSERT (seq != NULL);
+
+  barrier ();
+  if (s % 2 == 0 && seq->seq == s)
+    return false;
+  seq->retry_cnt++;
+  return true;
+}
+
+/* Begins a write to data protected by SEQ, waiting for any other
+   writer to finish first. */
+void
+seqlock_write_begin (struct seqlock *seq) 
+{
+  ASSERT (seq != NULL);
+
+  lock_acquire (&seq->write_lock);
+  seq->write_cnt++;
+  seq->seq++;
+  barrier ();
+}
+
+/* Ends a write begun with seqlock_write_begin(). */
+void
+seqlock_write_end (struct seqlock *seq) 
+{
+  ASSERT (seq != NULL);
+  ASSERT (seq->seq % 2 == 1);
+
+  barrier ();
+  seq->seq++;
+  lock_release (&seq->write_lock);
+}
+
+/* Names SEMA and, if lock profiling is on, starts keeping its
+   contention statistics in STATS, which must stay allocated as
+   long as SEMA does.  NAME is not copied. */
+void
+sema_profile (struct semaphore *sema, struct lock_stats *stats,
+              const char *name) 
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+  ASSERT (stats != NULL);
+  ASSERT (name != NULL);
+
+  if (!lock_profiling)
+    return;
+
+  memset (stats, 0, sizeof *stats);
+  stats->name = name;
+
+  old_level = intr_disable ();
+  list_push_back (&profiled_list, &stats->elem);
+  sema->stats = stats;
+  intr_set_level (old_level);
+}
+
+/* Names LOCK and, if lock profiling is on, starts keeping its
+   contention statistics in STATS, as for sema_profile().  Must
+   be called after lock_init(). */
+void
+lock_profile (struct lock *lock, struct lock_stats *stats,
+              const char *name) 
+{
+  ASSERT (lock != NULL);
+
+  sema_profile (&lock->semaphore, stats, name);
+}
+
+/* Prints the statistics of every profiled lock and semaphore
+   that has been acquired at least once. */
+void
+lock_print_stats (void) 
+{
+  struct list_elem *e;
+
+  if (!lock_profiling)
+    return;
+
+  for (e = list_begin (&profiled_list); e != list_end (&profiled_list);
+       e = list_next (e)) 
+    {
+      struct lock_stats *s = list_entry (e, struct lock_stats, elem);
+      if (s->acquire_cnt == 0)
+        continue;
+      printf ("Lock: %s: %lu acquisitions, %lu contended, "
+              "%"PRIu64" cycles waiting, %"PRIu64" cycles max hold\n",
+              s->name, s->acquire_cnt, s->contended_cnt,
+              s->wait_cycles, s->max_hold_cycles);
+    }
+}
+
 bool
 semaphore_elem_thread_priority_less (
     const struct list_elem *a,
@@ -3,12 +3,14 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    struct lock_stats *stats;   /* Contention statistics, or null. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -31,6 +33,28 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Contention statistics for a named lock or semaphore, kept only
+   if profiling was turned on with the "-lockstat" option.  Times
+   are in CPU cycles, since most locks are held for far less than
+   a timer tick. */
+struct lock_stats 
+  {
+    const char *name;           /* Name, for lock_print_stats(). */
+    struct list_elem elem;      /* Element in list of profiled locks. */
+    unsigned long acquire_cnt;  /* Acquisitions. */
+    unsigned long contended_cnt; /* Acquisitions that had to wait. */
+    uint64_t wait_cycles;       /* Total time spent waiting. */
+    uint64_t max_hold_cycles;   /* Longest time held (locks only). */
+    uint64_t acquired_at;       /* When the current holder acquired it. */
+  };
+
+extern bool lock_profiling;
+
+void sema_profile (struct semaphore *, struct lock_stats *,
+                   const char *name);
+void lock_profile (struct lock *, struct lock_stats *, const char *name);
+void lock_print_stats (void);
+
 /* Condition variable. */
 struct condition 
   {
@@ -42,6 +66,44 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader/writer lock. */
+struct rwlock 
+  {
+    struct lock write_lock;     /* Held by writer, or by a reader entering. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+    int reader_cnt;             /* Number of readers inside. */
+    bool draining;              /* Writer waiting for readers to leave? */
+
+    /* Statistics. */
+    unsigned long read_cnt;     /* Read acquisitions. */
+    unsigned long write_cnt;    /* Write acquisitions. */
+    unsigned long read_waits;   /* Read acquisitions that had to wait. */
+    unsigned long write_waits;  /* Write acquisitions that had to wait. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+
+/* Sequence lock. */
+struct seqlock 
+  {
+    unsigned seq;               /* Odd while a write is in progress. */
+    struct lock write_lock;     /* Serializes writers. */
+
+    /* Statistics. */
+    unsigned long write_cnt;    /* Writes. */
+    unsigned long retry_cnt;    /* Reads retried because of a write. */
+  };
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (struct seqlock *);
+bool seqlock_read_retry (struct seqlock *, unsigned seq);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
 bool semaphore_elem_thread_priority_less (
     const struct list_elem *a,
     const struct list_elem *b,
@@ -51,7 +113,10 @@ bool lock_priority_less (
     const struct list_elem *b,
     void *aux);
 
-#define lock_priority(LOCK) list_entry(list_begin(&LOCK->semaphore.waiters), struct thread, elem)->priority
+#define lock_priority(LOCK) \
+  (list_empty (&(LOCK)->semaphore.waiters) ? 0 \
+   : list_entry (list_begin (&(LOCK)->semaphore.waiters), \
+                 struct thread, elem)->priority)
 
 /* Optimization barrier.
 
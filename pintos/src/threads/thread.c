@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -10,6 +11,7 @@
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 #include "lib/kernel/list.h"
@@ -23,13 +25,14 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* List of processes in THREAD_BLOCK state
-   made by jh2ekd */
-static struct list sleep_list;
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority, and bit P of ready_mask
+   is set whenever ready_queues[P] is nonempty, so that finding the
+   highest-priority ready thread takes a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Number of ready threads. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -56,6 +59,9 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long switch_cnt;    /* # of context switches. */
+static uint64_t tick_cycles;    /* Total cycles spent in thread_tick(). */
+static uint64_t tick_cycles_max; /* Most cycles taken by one thread_tick(). */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -68,6 +74,19 @@ bool thread_mlfqs;
 
 static int fixed_load_avg;
 
+/* The MLFQS decays every runnable thread's recent_cpu once a
+   second.  Blocked threads are skipped, and catch up when they
+   are unblocked, using the decay coefficients saved here for the
+   last DECAY_HISTORY seconds. */
+#define DECAY_HISTORY 64
+static int decay_coeffs[DECAY_HISTORY];
+static int decay_seq;           /* Number of decays so far. */
+
+/* Threads whose recent_cpu has changed since the last time
+   priorities were recomputed, linked through mlfqs_elem.  Only
+   these threads' priorities can have changed. */
+static struct list recent_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -79,8 +98,18 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
-
-#define ready_threads ((int)list_size(&ready_list) + (thread_current () != idle_thread? 1 : 0))
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void set_priority (struct thread *, int priority);
+static int mlfqs_priority (const struct thread *);
+static timeout_func wake_sleeper;
+static void mlfqs_mark_recent (struct thread *);
+static void mlfqs_decay (void);
+static void mlfqs_catch_up (struct thread *);
+static void mlfqs_update_priorities (void);
+
+#define ready_threads (ready_cnt + (thread_current () != idle_thread? 1 : 0))
 
 #define fixed_point_f 16384 //16384 = 2^14. It is 17.14 fixed-point
 #define CALC_PRIORITY_TICK 4
@@ -101,12 +130,15 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
-  list_init (&sleep_list);
+  list_init (&recent_list);
 
   fixed_load_avg = conv2fixed (0);
 
@@ -145,9 +177,8 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
-  struct thread *t_e;
-  struct list_elem *e;
-  bool any_unblock = false;
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
   enum intr_level old_level;
 
   old_level = intr_disable ();
@@ -164,49 +195,31 @@ thread_tick (void)
   /* Think about race condition */
   /* calculate load_avg if thread_mlfqs is ture */
   if (thread_mlfqs){
-    t->fixed_recent_cpu = add_x_n (t->fixed_recent_cpu,1);
+    if (t != idle_thread){
+      t->fixed_recent_cpu = add_x_n (t->fixed_recent_cpu,1);
+      mlfqs_mark_recent (t);
+    }
 
     if (timer_ticks()%TIMER_FREQ==0){
       /* calc load_avg */
       fixed_load_avg = add_x_y (mul_x_y (div_x_n (conv2fixed (59), 60), fixed_load_avg),
 	  mul_x_n (div_x_n (conv2fixed (1), 60), ready_threads));
-      if (!list_empty(&all_list)){
-  	for (e = list_begin (&all_list); e != list_tail(&all_list); e = list_next (e)){
-  	  t_e = list_entry(e, struct thread, allelem);
-  	  if (t_e != idle_thread)
-  	    t_e->fixed_recent_cpu = add_x_n (mul_x_y (div_x_y (mul_x_n (fixed_load_avg, 2),
-  		    add_x_n (mul_x_n (fixed_load_avg, 2), 1)), t_e->fixed_recent_cpu), t_e->nice);
-  	}
-      }
+      mlfqs_decay ();
     }
-    if ((timer_ticks()%CALC_PRIORITY_TICK==0) && (!list_empty(&all_list))){
-      for (e = list_begin (&all_list); e != list_tail(&all_list); e = list_next (e)){
-	t_e = list_entry(e, struct thread, allelem);
-	if (t_e != idle_thread){
-//  	  thread_donate_priority (t_e, PRI_MAX-round2int (div_x_n (t_e->fixed_recent_cpu, 4))-((t_e->nice)*2));
-	  t_e->priority = PRI_MAX-round2int (div_x_n (t_e->fixed_recent_cpu, 4))-((t_e->nice)*2);
-/*	  if (t_e->status == THREAD_READY){
-	    list_remove(&t_e->elem);
-	    list_insert_ordered (&ready_list, &t_e->elem, (list_less_func*)thread_priority_more, NULL);
-	  }*/
-	}
-      }
+    if (timer_ticks()%CALC_PRIORITY_TICK==0){
+      mlfqs_update_priorities ();
       intr_yield_on_return();
     }
   }
 
-  /* Wake sleeping threads */
-  while (list_entry(list_begin (&sleep_list), struct thread, sleepelem) -> waketime <=timer_ticks()
-      && list_begin (&sleep_list) != list_end (&sleep_list)){
-    thread_unblock(list_entry(list_pop_front(&sleep_list), struct thread, sleepelem));
-    any_unblock = true;
-  }
-
-  if (any_unblock)
-    intr_yield_on_return();
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
+
+  cycles = rdtsc () - start;
+  tick_cycles += cycles;
+  if (cycles > tick_cycles_max)
+    tick_cycles_max = cycles;
   intr_set_level (old_level);
 }
 
@@ -214,8 +227,14 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  long long ticks = idle_ticks + kernel_ticks + user_ticks;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld context switches\n", switch_cnt);
+  if (ticks > 0)
+    printf ("Thread: tick handler took %"PRIu64" cycles max, "
+            "%"PRIu64" average\n", tick_cycles_max, tick_cycles / ticks);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -284,8 +303,10 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+#ifdef FILESYS
   if(thread_current()->wd != NULL)
     t->wd = dir_reopen(thread_current()->wd);
+#endif
 
   intr_set_level (old_level);
 
@@ -332,39 +353,39 @@ thread_unblock (struct thread *t)
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
   
-  list_insert_ordered (&ready_list, &t->elem, (list_less_func*)thread_priority_more, NULL);
+  /* Bring T's priority up to date after blocking.  The idle
+     thread, unblocked only when it is created, has none. */
+  if (thread_mlfqs && idle_thread != NULL){
+    mlfqs_catch_up (t);
+    t->priority = mlfqs_priority (t);
+  }
+  ready_push (t);
   t->status = THREAD_READY;
 
   intr_set_level (old_level);
 }
 
-/* put thread into sleep_list and block it */
+/* Blocks the current thread until timer tick WAKETIME. */
 void
 thread_sleep (int64_t waketime)
 {
-  void* aux;
   struct thread* cur = thread_current();
   enum intr_level old_level;
 
   old_level = intr_disable ();
-  (cur->waketime) = waketime;
-  aux = 0;
-  list_insert_ordered (&sleep_list, &(cur->sleepelem),
-      (list_less_func*)thread_waketime_less, aux);
+  timeout_add (&cur->sleep_timeout, waketime, wake_sleeper, cur);
   thread_block ();
   intr_set_level (old_level);
 }
 
-bool thread_waketime_less (const struct list_elem *a,
-    const struct list_elem *b, void *aux UNUSED){
-  struct thread* thread_a = (struct thread*)(list_entry(a, struct thread, sleepelem));
-  struct thread* thread_b = (struct thread*)(list_entry(b, struct thread, sleepelem));
-  if ( thread_a->waketime == thread_b->waketime )
-    return thread_a->priority > thread_b->priority?
-      true : false;
-  else
-  return thread_a->waketime < thread_b->waketime?
-    true : false;
+/* Wakes the thread that set sleep timeout T.  Threads woken on
+   the same tick go into the run queues together, and the
+   scheduler then picks among them by priority. */
+static void
+wake_sleeper (struct timeout *t)
+{
+  thread_unblock (t->aux);
+  intr_yield_on_return ();
 }
 
 bool thread_priority_more (const struct list_elem *a,
@@ -424,6 +445,8 @@ thread_exit (void)
      when it call thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
+  if (thread_current ()->ran_recently)
+    list_remove (&thread_current ()->mlfqs_elem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -440,16 +463,39 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur->priority <= list_entry(list_begin(&ready_list), struct thread, elem)->priority){
-    if (cur != idle_thread){ 
-      list_insert_ordered (&ready_list, &cur->elem, (list_less_func*)thread_priority_more, NULL);
-      cur->status = THREAD_READY;
-      schedule ();
-    }
+  if (cur != idle_thread && cur->priority <= ready_max_priority ()){
+    ready_push (cur);
+    cur->status = THREAD_READY;
+    schedule ();
   }
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Within an interrupt handler, arranges to
+   yield on return from the interrupt instead. */
+void
+thread_yield_to_higher (void) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (ready_max_priority () > thread_current ()->priority) 
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the number of context switches since the OS booted. */
+long long
+thread_switch_count (void) 
+{
+  return switch_cnt;
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -497,16 +543,14 @@ thread_get_priority (void)
 void
 thread_donate_priority(struct thread *thread, const int new_priority)
 {
-  thread->priority = new_priority;
+  set_priority (thread, new_priority);
   if (thread->locked_by != NULL
       && thread->locked_by->holder->priority < new_priority){
     thread_donate_priority (thread->locked_by->holder, new_priority);
   }
-  /* if it is in ready_list, rearrange ready_list */
+  /* set_priority() already moved a ready thread to its new run
+     queue, but it may now outrank us */
   else if (thread->status == THREAD_READY){
-    list_remove (&thread->elem);
-    list_insert_ordered (&ready_list, &thread->elem,
-	(list_less_func*)thread_priority_more, NULL);
     if (!intr_context())
       thread_yield();
   }
@@ -518,7 +562,7 @@ thread_set_nice (int nice)
 {
   struct thread *t = thread_current();
   t->nice = nice;
-  t->priority =  PRI_MAX-div_x_n (t->fixed_recent_cpu, 4)-(nice*2);
+  t->priority = mlfqs_priority (t);
   thread_yield();
 }
 
@@ -565,6 +609,15 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Spend idle time zeroing free pages, a page at a time,
+         going back to the scheduler between pages. */
+      if (palloc_zero_idle ())
+        continue;
+
+      /* Stop the timer tick until there is something for it to
+         do.  Whatever interrupt wakes us up restarts it. */
+      timer_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -629,6 +682,7 @@ init_thread (struct thread *t, const char *name, int priority)
   t->orig_priority = priority;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
+  t->decay_seq = decay_seq;
   t->locked_by = NULL;
   t->exit_code = 0;
   t->end = false;
@@ -639,9 +693,14 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init (&t->children_list);
   list_init (&t->lock_list);
 
-  memset (&t->fd_list, 0, (sizeof(struct file*)) * FD_MAX);
-  t->fd_num = 2;
+#ifdef USERPROG
+  fd_table_init (&t->fds);
+#endif
   t->wd = NULL;
+#ifdef VM
+  list_init (&t->mmaps);
+  t->next_mapid = 0;
+#endif
   list_push_back (&all_list, &t->allelem);
 }
 
@@ -666,17 +725,158 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  struct list_elem *t_e;
-  if (list_empty (&ready_list))
+  int priority = ready_max_priority ();
+  struct thread *t;
+
+  if (priority < 0)
     return idle_thread;
-  else{
-    if (thread_mlfqs){
-      t_e = list_min (&ready_list, (list_less_func*)thread_priority_more, NULL);
-      list_remove (t_e);
-      return list_entry(t_e, struct thread, elem);
-    }
-    else
-      return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  t = list_entry (list_front (&ready_queues[priority]), struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+/* Adds T to the back of the run queue for its priority. */
+static void
+ready_push (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_mask |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/* Removes T from its run queue.  T's priority must not have
+   changed since it was queued. */
+static void
+ready_remove (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_mask &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready. */
+static int
+ready_max_priority (void) 
+{
+  uint32_t hi = ready_mask >> 32;
+  uint32_t lo = ready_mask;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return -1;
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready.  Interrupts must be off. */
+static void
+set_priority (struct thread *t, int priority) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->status == THREAD_READY && t->priority != priority){
+    ready_remove (t);
+    t->priority = priority;
+    ready_push (t);
+  }
+  else
+    t->priority = priority;
+}
+
+/* Returns the priority the MLFQS gives T:
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to the valid
+   range. */
+static int
+mlfqs_priority (const struct thread *t) 
+{
+  int priority = PRI_MAX - round2int (div_x_n (t->fixed_recent_cpu, 4))
+                 - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
+}
+
+/* Adds T to recent_list, if it is not there already, so that its
+   priority is recomputed at the next 4-tick boundary. */
+static void
+mlfqs_mark_recent (struct thread *t) 
+{
+  if (!t->ran_recently){
+    list_push_back (&recent_list, &t->mlfqs_elem);
+    t->ran_recently = true;
+  }
+}
+
+/* Applies this second's decay to the recent_cpu of the running
+   thread and every ready thread, and saves the coefficient for
+   the blocked threads to apply when they wake up. */
+static void
+mlfqs_decay (void) 
+{
+  int coeff = div_x_y (mul_x_n (fixed_load_avg, 2),
+                       add_x_n (mul_x_n (fixed_load_avg, 2), 1));
+  struct thread *cur = running_thread ();
+  struct list_elem *e;
+  int i;
+
+  decay_coeffs[decay_seq++ % DECAY_HISTORY] = coeff;
+  if (cur != idle_thread)
+    mlfqs_catch_up (cur);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    for (e = list_begin (&ready_queues[i]); e != list_end (&ready_queues[i]);
+         e = list_next (e))
+      mlfqs_catch_up (list_entry (e, struct thread, elem));
+}
+
+/* Applies to T's recent_cpu the decays it has missed, and marks
+   T for a priority update.  If T missed more than DECAY_HISTORY
+   seconds, the oldest coefficient saved stands in for the ones
+   lost; after that long, T's starting value hardly matters. */
+static void
+mlfqs_catch_up (struct thread *t) 
+{
+  int missed = decay_seq - t->decay_seq;
+  int seq, i;
+
+  if (missed <= 0)
+    return;
+  if (missed > DECAY_HISTORY){
+    int oldest = decay_coeffs[decay_seq % DECAY_HISTORY];
+    for (i = DECAY_HISTORY; i < missed && i < 2 * DECAY_HISTORY; i++)
+      t->fixed_recent_cpu = add_x_n (mul_x_y (oldest, t->fixed_recent_cpu),
+                                     t->nice);
+    t->decay_seq = decay_seq - DECAY_HISTORY;
+  }
+  for (seq = t->decay_seq; seq < decay_seq; seq++)
+    t->fixed_recent_cpu = add_x_n (mul_x_y (decay_coeffs[seq % DECAY_HISTORY],
+                                            t->fixed_recent_cpu), t->nice);
+  t->decay_seq = decay_seq;
+  mlfqs_mark_recent (t);
+}
+
+/* Recomputes the priority of each thread in recent_list, the
+   only ones whose recent_cpu has changed since the last time,
+   and empties the list. */
+static void
+mlfqs_update_priorities (void) 
+{
+  while (!list_empty (&recent_list)){
+    struct thread *t = list_entry (list_pop_front (&recent_list),
+                                   struct thread, mlfqs_elem);
+    t->ran_recently = false;
+    set_priority (t, mlfqs_priority (t));
   }
 }
 
@@ -744,8 +944,11 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
-  if (cur != next)
-    prev = switch_threads (cur, next);
+  if (cur != next) 
+    {
+      switch_cnt++;
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev); 
 }
 
@@ -766,10 +969,12 @@ allocate_tid (void)
 void
 print_ready_list(void)
 {
-  struct list* list = &ready_list;
   struct list_elem *e;
-  for(e = list_begin (list); e != list_end (list); e = list_next(e))
-    printf("-> %s ", list_entry(e, struct thread, elem)->name);
+  int i;
+  for(i = PRI_MAX; i >= PRI_MIN; i--)
+    for(e = list_begin (&ready_queues[i]); e != list_end (&ready_queues[i]);
+        e = list_next(e))
+      printf("-> %s ", list_entry(e, struct thread, elem)->name);
   printf("\n");
 }
 
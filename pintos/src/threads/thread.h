@@ -5,8 +5,15 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
+#include "devices/timeout.h"
 #include "filesys/file.h"
 #include "filesys/directory.h"
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -27,7 +34,6 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-#define FD_MAX 250                       /* For project 2 */
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -101,7 +107,6 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
-    struct list_elem sleepelem; 
     struct list_elem childelem;
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -110,13 +115,16 @@ struct thread
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
-    int64_t waketime;                   /* time to wake */
+    struct timeout sleep_timeout;       /* Wakes thread_sleep(). */
 
     struct list lock_list;              /* list of lock held by it */
     struct lock* locked_by;              /* it is locked by */
 
     int fixed_recent_cpu; //For project #1, advanced shceduling
     int nice;
+    int decay_seq;                      /* Decays applied to recent_cpu. */
+    bool ran_recently;                  /* In thread.c's recent_list? */
+    struct list_elem mlfqs_elem;        /* recent_list element. */
 
     int exit_code; //For project #2
     bool end;
@@ -126,11 +134,20 @@ struct thread
     struct semaphore kill_this;
 
     char process_name[16];
-    struct file *fd_list[FD_MAX];
-    int fd_num; 
+#ifdef USERPROG
+    struct fd_table fds;                /* Open file descriptors. */
+#endif
     struct file *open_file;
 
     struct dir* wd;//working directory
+
+#ifdef VM
+    /* Owned by vm/page.c and vm/mmap.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct list mmaps;                  /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+    void *user_esp;                     /* User %esp on entry to kernel. */
+#endif
   };
 
 /* If false (default), use round-robin scheduler.
@@ -157,6 +174,8 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_to_higher (void);
+long long thread_switch_count (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -170,8 +189,6 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-bool thread_waketime_less (const struct list_elem *a,
-		    const struct list_elem *b, void *aux);
 bool thread_priority_more (const struct list_elem *a,
 		    const struct list_elem *b, void *aux);
 void print_ready_list(void);
@@ -0,0 +1,163 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+/* Work items waiting for a worker, in order of queuing. */
+static struct list queue;
+
+/* Counts the items in QUEUE; workers wait on it. */
+static struct semaphore queue_sema;
+
+/* Statistics. */
+static long long queue_cnt;     /* # of times an item was queued. */
+static long long merge_cnt;     /* # of requests merged into a queued item. */
+static long long run_cnt;       /* # of items run. */
+
+static thread_func worker;
+static timeout_func delayed_work_fire;
+static void enqueue (struct work *);
+
+/* Initializes the work queue and starts its workers.  Must be
+   called after thread_start(). */
+void
+workqueue_init (void) 
+{
+  int i;
+
+  list_init (&queue);
+  sema_init (&queue_sema, 0);
+  for (i = 0; i < WORKER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "worker %d", i);
+      thread_create (name, PRI_DEFAULT, worker, NULL);
+    }
+}
+
+/* Initializes W to call FUNC, with W's aux member set to AUX,
+   whenever it is run. */
+void
+work_init (struct work *w, work_func *func, void *aux) 
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Queues W to be run by a worker.  Returns true if W was queued,
+   false if it was already waiting to run, in which case this
+   request is served by that run.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue (struct work *w) 
+{
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  queued = !w->pending;
+  if (queued) 
+    {
+      w->pending = true;
+      enqueue (w);
+    }
+  else
+    merge_cnt++;
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Queues W to be run by a worker once TICKS timer ticks have
+   passed.  Returns true if W was queued, false if it was already
+   waiting, with or without a delay.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue_delayed (struct work *w, int64_t ticks) 
+{
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT (w != NULL);
+
+  if (ticks <= 0)
+    return work_queue (w);
+
+  old_level = intr_disable ();
+  queued = !w->pending;
+  if (queued) 
+    {
+      w->pending = true;
+      timeout_add (&w->timeout, timer_ticks () + ticks,
+                   delayed_work_fire, w);
+    }
+  else
+    merge_cnt++;
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void) 
+{
+  printf ("Workqueue: %lld items queued, %lld requests merged, "
+          "%lld items run\n", queue_cnt, merge_cnt, run_cnt);
+}
+
+/* Adds W, already marked pending, to the queue and wakes a
+   worker.  Interrupts must be off. */
+static void
+enqueue (struct work *w) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&queue, &w->elem);
+  queue_cnt++;
+  sema_up (&queue_sema);
+}
+
+/* Queues the work item whose delay, set by work_queue_delayed(),
+   has expired.  Runs in the timer interrupt. */
+static void
+delayed_work_fire (struct timeout *t) 
+{
+  enqueue (t->aux);
+}
+
+/* Worker thread.  Runs queued work items, one at a time, in the
+   order they were queued. */
+static void
+worker (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      sema_down (&queue_sema);
+
+      old_level = intr_disable ();
+      w = list_entry (list_pop_front (&queue), struct work, elem);
+      w->pending = false;
+      run_cnt++;
+      intr_set_level (old_level);
+
+      w->func (w);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timeout.h"
+
+/* Kernel work queue.
+
+   Background jobs, such as writing back the buffer cache, are
+   queued as work items and run by a small pool of shared worker
+   threads, instead of each job owning a thread that sleeps most
+   of the time.
+
+   The caller owns each struct work, typically embedded in a
+   larger structure, and must keep it alive while it is queued.
+   A work item is queued at most once at a time: queuing it again
+   before it starts running does nothing, so requests made in the
+   meantime are batched into a single run, and the queue never
+   holds more entries than there are work items.  A work item
+   queued again while it runs may start on a second worker before
+   the first run finishes. */
+
+struct work;
+typedef void work_func (struct work *);
+
+struct work
+  {
+    struct list_elem elem;      /* Element in the queue. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* For use by FUNC. */
+    bool pending;               /* Queued and not yet started? */
+    struct timeout timeout;     /* For work_queue_delayed(). */
+  };
+
+void workqueue_init (void);
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *);
+bool work_queue_delayed (struct work *, int64_t ticks);
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
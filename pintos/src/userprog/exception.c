@@ -3,8 +3,13 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -149,6 +154,29 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* A not-present user page may simply not have been brought in
+     yet, or may be the next page of a growing stack.  This also
+     covers the kernel touching user buffers during system calls,
+     which use the stack pointer saved by the system call
+     handler. */
+  if (user)
+    thread_current ()->user_esp = f->esp;
+  if (not_present && is_user_vaddr (fault_addr) && page_in (fault_addr))
+    return;
+
+  /* A write to a read-only page may be to a page shared
+     copy-on-write with a parent or child process. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_copy_on_write (fault_addr))
+    return;
+#endif
+
+  /* A kernel fault on a user address inside one of the user copy
+     routines just makes the copy fail. */
+  if (!user && is_user_vaddr (fault_addr) && uaccess_fixup (f))
+    return;
+
   sys_exit(-1);
 
   /* To implement virtual memory, delete the rest of the function
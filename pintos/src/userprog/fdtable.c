@@ -0,0 +1,157 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+
+/* Number of slots in a table when it is first used. */
+#define FD_INITIAL_SIZE 16
+
+static bool fd_table_resize (struct fd_table *, int size);
+
+/* Initializes T as an empty table.  Allocates no memory. */
+void
+fd_table_init (struct fd_table *t)
+{
+  t->files = NULL;
+  t->used = NULL;
+  t->size = 0;
+  t->hint = FD_FIRST;
+}
+
+/* Fills empty table DST with new handles on the files open in
+   SRC, under the same descriptors and at the same positions.
+   Returns false if memory allocation fails, in which case DST
+   may be partly filled and should be destroyed. */
+bool
+fd_table_copy (struct fd_table *dst, const struct fd_table *src)
+{
+  int fd;
+
+  ASSERT (dst->size == 0);
+
+  if (src->size == 0)
+    return true;
+  if (!fd_table_resize (dst, src->size))
+    return false;
+
+  for (fd = FD_FIRST; fd < src->size; fd++)
+    if (src->files[fd] != NULL)
+      {
+        struct file *file = file_reopen (src->files[fd]);
+        if (file == NULL)
+          return false;
+        file_seek (file, file_tell (src->files[fd]));
+        dst->files[fd] = file;
+        bitmap_mark (dst->used, fd);
+      }
+  dst->hint = src->hint;
+  return true;
+}
+
+/* Closes every file open in T and frees T's memory, leaving it
+   empty. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  int fd;
+
+  for (fd = FD_FIRST; fd < t->size; fd++)
+    file_close (t->files[fd]);
+  free (t->files);
+  if (t->used != NULL)
+    bitmap_destroy (t->used);
+  fd_table_init (t);
+}
+
+/* Adds FILE to T under the lowest free descriptor, growing T if
+   it is full.  Returns the descriptor, or -1 if memory allocation
+   fails. */
+int
+fd_alloc (struct fd_table *t, struct file *file)
+{
+  size_t fd = BITMAP_ERROR;
+
+  ASSERT (file != NULL);
+
+  if (t->used != NULL)
+    fd = bitmap_scan_and_flip (t->used, t->hint, 1, false);
+  if (fd == BITMAP_ERROR)
+    {
+      if (!fd_table_resize (t, t->size > 0 ? t->size * 2 : FD_INITIAL_SIZE))
+        return -1;
+      fd = bitmap_scan_and_flip (t->used, t->hint, 1, false);
+      ASSERT (fd != BITMAP_ERROR);
+    }
+
+  t->files[fd] = file;
+  t->hint = fd + 1;
+  return fd;
+}
+
+/* Returns the file open as FD in T, or a null pointer if FD is
+   not open. */
+struct file *
+fd_lookup (const struct fd_table *t, int fd)
+{
+  if (fd < FD_FIRST || fd >= t->size)
+    return NULL;
+  return t->files[fd];
+}
+
+/* Removes FD from T and returns the file it referred to, which
+   the caller should close, or a null pointer if FD was not
+   open. */
+struct file *
+fd_remove (struct fd_table *t, int fd)
+{
+  struct file *file = fd_lookup (t, fd);
+
+  if (file != NULL)
+    {
+      t->files[fd] = NULL;
+      bitmap_reset (t->used, fd);
+      if (fd < t->hint)
+        t->hint = fd;
+    }
+  return file;
+}
+
+/* Grows T to SIZE slots.  Returns false if memory allocation
+   fails, in which case T is unchanged. */
+static bool
+fd_table_resize (struct fd_table *t, int size)
+{
+  struct file **files;
+  struct bitmap *used;
+  int fd;
+
+  ASSERT (size > t->size && size > FD_FIRST);
+
+  /* Create the new bitmap first: if growing the array then
+     fails, the bitmap is the only thing to undo, and realloc()
+     has left the old array as it was. */
+  used = bitmap_create (size);
+  if (used == NULL)
+    return false;
+  files = realloc (t->files, sizeof *files * size);
+  if (files == NULL)
+    {
+      bitmap_destroy (used);
+      return false;
+    }
+  t->files = files;
+
+  for (fd = 0; fd < t->size; fd++)
+    if (bitmap_test (t->used, fd))
+      bitmap_mark (used, fd);
+  for (fd = t->size; fd < size; fd++)
+    files[fd] = NULL;
+  bitmap_set_multiple (used, 0, FD_FIRST, true);
+
+  if (t->used != NULL)
+    bitmap_destroy (t->used);
+  t->used = used;
+  t->size = size;
+  return true;
+}
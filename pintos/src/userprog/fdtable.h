@@ -0,0 +1,34 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+struct bitmap;
+struct file;
+
+/* Descriptors 0 and 1 are the console and never hold a file. */
+#define FD_FIRST 2
+
+/* A process's open file descriptors.
+
+   The table starts out empty, with no memory allocated, and
+   doubles in size whenever it fills up.  A new file always gets
+   the lowest free descriptor: every descriptor below HINT is in
+   use, so the search for a free one starts there. */
+struct fd_table
+  {
+    struct file **files;        /* Open files, indexed by descriptor. */
+    struct bitmap *used;        /* Descriptors in use. */
+    int size;                   /* Number of slots in FILES and USED. */
+    int hint;                   /* No free descriptor below this. */
+  };
+
+void fd_table_init (struct fd_table *);
+bool fd_table_copy (struct fd_table *, const struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+
+int fd_alloc (struct fd_table *, struct file *);
+struct file *fd_lookup (const struct fd_table *, int fd);
+struct file *fd_remove (struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -18,7 +18,15 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "filesys/directory.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent);
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 void push_arg_str (void **esp, char *str, int length);
 void push_arg_addr (void **esp, void *addr);
@@ -133,6 +141,104 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Passed from process_fork() to start_fork(). */
+struct fork_info
+  {
+    struct thread *parent;              /* Forking process. */
+    struct intr_frame if_;              /* Its user registers. */
+  };
+
+/* Starts a new process that is a copy of the current one and
+   resumes from system call frame F, seeing a return value of 0.
+   Memory is shared copy-on-write and open files are reopened at
+   the same positions.  Returns the new process's thread id, or
+   TID_ERROR if it cannot be created. */
+tid_t
+process_fork (const struct intr_frame *f)
+{
+  struct fork_info fi;
+  struct thread *child_t;
+  tid_t tid;
+
+  fi.parent = thread_current ();
+  fi.if_ = *f;
+  tid = thread_create (fi.parent->process_name, thread_get_priority (),
+                       start_fork, &fi);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  /* FI lives on our stack, so wait until the child is done with
+     it. */
+  child_t = find_child (tid, fi.parent);
+  sema_down (&child_t->wait_start_process);
+  if (child_t->success_to_load)
+    return tid;
+  list_remove (&child_t->childelem);
+  sema_up (&child_t->kill_this);
+  return TID_ERROR;
+}
+
+/* A thread function that copies the forking process and returns
+   to user mode in the copy. */
+static void
+start_fork (void *fi_)
+{
+  struct fork_info *fi = fi_;
+  struct thread *parent = fi->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = fi->if_;
+  bool success = false;
+
+  strlcpy (t->process_name, parent->process_name, sizeof t->process_name);
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL && !page_table_init (&t->pages))
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+    }
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      success = fork_files (parent) && page_fork (parent);
+    }
+  t->success_to_load = success;
+  sema_up (&t->wait_start_process);
+
+  /* If copying failed, quit. */
+  if (!success){
+    fd_table_destroy (&t->fds);
+    if (t->success_to_open){
+      file_allow_write (t->open_file);
+      file_close (t->open_file);
+    }
+    sema_down (&t->kill_this);
+    thread_exit ();
+  }
+
+  /* fork() returns 0 in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives the current process its own handles on PARENT's
+   executable and open files, at the same positions. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+
+  t->open_file = file_reopen (parent->open_file);
+  if (t->open_file == NULL)
+    return false;
+  t->success_to_open = true;
+  file_deny_write (t->open_file);
+
+  return fd_table_copy (&t->fds, &parent->fds);
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -166,11 +272,22 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  /* Close any files left open, as when killed by an
+     exception. */
+  fd_table_destroy (&cur->fds);
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+#ifdef VM
+      /* Write back and drop mapped files while the page
+         directory still records which pages are dirty. */
+      mmap_unmap_all ();
+      page_table_destroy (&cur->pages);
+#endif
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -288,6 +405,14 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) {
     goto done;
   }
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -391,7 +516,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -450,6 +577,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, nothing is read here: each page is only recorded in
+   the supplemental page table and is read in by the page fault
+   handler on first access.  Pages that are entirely zero are
+   never read from FILE at all.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -460,6 +592,24 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      if (page_add_file (upage, page_read_bytes > 0 ? file : NULL, ofs,
+                         page_read_bytes, writable, false) == NULL)
+        return false;
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -495,6 +645,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -502,6 +653,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  /* The page is zero-filled when the arguments are pushed. */
+  if (page_add_file (((uint8_t *) PHYS_BASE) - PGSIZE, NULL, 0, 0,
+                     true, false) == NULL)
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -515,8 +674,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -536,6 +697,7 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
 
 /* Team 13's function.
    push argument n string and put NULL*/
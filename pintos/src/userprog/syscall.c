@@ -12,11 +12,19 @@
 #include "devices/input.h"
 #include "devices/shutdown.h"
 
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/uaccess.h"
+#include <iovec.h>
+#include <limits.h>
 #include <string.h>
-#define under_phys_base(addr) if((void*)addr >= PHYS_BASE) sys_exit(-1);
-#define esp_under_phys_base(f, args_num) under_phys_base(((int*)(f->esp)+args_num+1))
-#define check_fd(fd, fail, f) if(fd < 0 || fd >= FD_MAX) {f->eax = fail; break;}
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+#define check_fd(fd, fail, f) if(fd < 0) {f->eax = fail; break;}
 static void syscall_handler (struct intr_frame *f);
 static void sys_halt (void);
 static tid_t sys_exec(void *cmd_line, struct intr_frame *f);
@@ -30,11 +38,45 @@ static int sys_filesize (int fd, struct intr_frame *f);
 static void sys_seek (int fd, unsigned position, struct intr_frame *f);
 static unsigned sys_tell (int fd, struct intr_frame *f);
 static void sys_close (int fd, struct intr_frame *f);
+#ifdef VM
+static mapid_t sys_mmap (int fd, void *addr, struct intr_frame *f);
+static void sys_munmap (mapid_t mapping, struct intr_frame *f);
+static tid_t sys_fork (struct intr_frame *f);
+#endif
 static bool sys_chdir(const char *dir, struct intr_frame *f);
 static bool sys_mkdir(const char *dir, struct intr_frame *f);
 static bool sys_readdir(int fd, char *name, struct intr_frame *f);
 static bool sys_isdir(int fd, struct intr_frame *f);
 static int sys_inumber(int fd, struct intr_frame *f);
+static char *copy_in_string (const char *ustr);
+static bool copy_in_iov (const struct iovec *uiov, int iovcnt,
+                         struct iovec **iovp);
+static size_t read_console (void *ubuf, size_t size, bool wait);
+static void write_console (const void *ubuf, size_t size);
+static int sys_readv (int fd, const struct iovec *iov, int iovcnt, struct intr_frame *f);
+static int sys_writev (int fd, const struct iovec *iov, int iovcnt, struct intr_frame *f);
+static bool pin_range (const void *buffer, size_t size, bool will_write);
+static void pin_buffer (const void *buffer, size_t size, bool will_write);
+static bool pin_iov (const struct iovec *iov, int iovcnt, bool will_write);
+static void unpin_iov (const struct iovec *iov, int iovcnt);
+#ifdef VM
+static void unpin_buffer (const void *buffer, size_t size);
+#else
+#define unpin_buffer(BUFFER, SIZE) ((void) (BUFFER), (void) (SIZE))
+#endif
+
+/* Number of argument words taken by each system call. */
+static const int syscall_argc[] =
+  {
+    [SYS_HALT] = 0, [SYS_EXIT] = 1, [SYS_EXEC] = 1, [SYS_WAIT] = 1,
+    [SYS_CREATE] = 2, [SYS_REMOVE] = 1, [SYS_OPEN] = 1,
+    [SYS_FILESIZE] = 1, [SYS_READ] = 3, [SYS_WRITE] = 3,
+    [SYS_SEEK] = 2, [SYS_TELL] = 1, [SYS_CLOSE] = 1,
+    [SYS_MMAP] = 2, [SYS_MUNMAP] = 1,
+    [SYS_CHDIR] = 1, [SYS_MKDIR] = 1, [SYS_READDIR] = 2,
+    [SYS_ISDIR] = 1, [SYS_INUMBER] = 1,
+    [SYS_READV] = 3, [SYS_WRITEV] = 3, [SYS_FORK] = 0,
+  };
 
 void
 syscall_init (void) 
@@ -46,109 +88,139 @@ static void
 syscall_handler (struct intr_frame *f) 
 {
   int sys_vector;
-  sys_vector=*(int *)(f->esp);
+  int args[3];
+  char *name;
+#ifdef VM
+  /* Page faults on user buffers may need it to grow the stack. */
+  thread_current ()->user_esp = f->esp;
+#endif
+  /* Fetch the system call number, then all of its arguments in
+     one copy.  A bad stack pointer just makes a copy fail. */
+  if (!copy_from_user (&sys_vector, f->esp, sizeof sys_vector))
+    sys_exit(-1);
+  if (sys_vector < 0
+      || sys_vector >= (int) (sizeof syscall_argc / sizeof *syscall_argc))
+    return;
+  if (!copy_from_user (args, (int *) f->esp + 1,
+                       syscall_argc[sys_vector] * sizeof *args))
+    sys_exit(-1);
+
   switch(sys_vector)
   {
   case SYS_HALT:
-    esp_under_phys_base(f, 0);
     sys_halt ();
     break;
   case SYS_EXIT:
-    if ((void *)((int *)f->esp + 1) >= PHYS_BASE)
-      sys_exit (-1);
-    else
-      sys_exit (*((int *)f->esp + 1));
+    sys_exit (args[0]);
     break;
   case SYS_EXEC:
-    esp_under_phys_base(f, 1);
-    under_phys_base (*((int **)f->esp + 1));
-    sys_exec (*((int **)f->esp + 1), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_exec (name, f);
+    palloc_free_page (name);
     break;
   case SYS_WAIT:
-    esp_under_phys_base(f, 1);
-    sys_wait (*((int *)f->esp + 1), f);
+    sys_wait (args[0], f);
     break;
   case SYS_CREATE:
-//    printf("why?\n");
-    if ((void*)*((int **)f->esp + 1) == NULL)
-      sys_exit(-1);
-    esp_under_phys_base(f, 2);
-    under_phys_base (*((int **)f->esp + 1));
-//    printf("123\n");
-    sys_create (*((int **)f->esp + 1), *((int *)f->esp + 2), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_create (name, args[1], f);
+    palloc_free_page (name);
     break;
   case SYS_REMOVE:
-    esp_under_phys_base(f, 1);
-    under_phys_base (*((int **)f->esp + 1));
-    sys_remove (*((int **)f->esp + 1), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_remove (name, f);
+    palloc_free_page (name);
     break;
   case SYS_OPEN:
-    if ((void*)*((int **)f->esp + 1) == NULL)
-      sys_exit(-1);
-    esp_under_phys_base(f, 1);
-    under_phys_base (*((int **)f->esp + 1));
-    sys_open (*((int **)f->esp + 1), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_open (name, f);
+    palloc_free_page (name);
     break;
   case SYS_FILESIZE:
-    esp_under_phys_base(f, 1);
-    check_fd(*((int *)f->esp + 1), -1, f);
-    sys_filesize (*((int *)f->esp + 1), f);
+    check_fd(args[0], -1, f);
+    sys_filesize (args[0], f);
     break;
   case SYS_READ:
-    esp_under_phys_base(f, 3);
-    under_phys_base (*((int **)f->esp + 2));
-    check_fd(*((int *)f->esp + 1), -1, f)
-    sys_read (*((int *)f->esp + 1), *((int **)f->esp + 2), *((int *)f->esp + 3), f);
+    check_fd(args[0], -1, f)
+    sys_read (args[0], (void *) args[1], args[2], f);
     break;
   case SYS_WRITE:
-    esp_under_phys_base(f, 3);
-    under_phys_base (*((int **)f->esp + 2));
-    check_fd(*((int *)f->esp + 1), -1, f)
-    sys_write (*((int *)f->esp + 1), *((int **)f->esp + 2), *((int *)f->esp + 3), f);
+    check_fd(args[0], -1, f)
+    sys_write (args[0], (void *) args[1], args[2], f);
     break;
   case SYS_SEEK:
-    esp_under_phys_base(f, 2);
-    check_fd(*((int *)f->esp + 1), 0, f)
-    sys_seek (*((int *)f->esp + 1), *((int *)f->esp + 2), f);
+    check_fd(args[0], 0, f)
+    sys_seek (args[0], args[1], f);
     break;
   case SYS_TELL:
-    esp_under_phys_base(f, 1);
-    check_fd(*((int *)f->esp + 1), 0, f)
-    sys_tell (*((int *)f->esp + 1), f);
+    check_fd(args[0], 0, f)
+    sys_tell (args[0], f);
     break;
   case SYS_CLOSE:
-    esp_under_phys_base(f, 1);
-    check_fd(*((int *)f->esp + 1), 0, f)
-    sys_close (*((int *)f->esp + 1), f);
+    check_fd(args[0], 0, f)
+    sys_close (args[0], f);
     break;
+#ifdef VM
+  case SYS_MMAP:
+    check_fd(args[0], -1, f)
+    sys_mmap (args[0], (void *) args[1], f);
+    break;
+  case SYS_MUNMAP:
+    sys_munmap (args[0], f);
+    break;
+#endif
   case SYS_CHDIR:
-    esp_under_phys_base(f, 1);
-    
-    sys_chdir (*((int **)f->esp + 1), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_chdir (name, f);
+    palloc_free_page (name);
     break;
   case SYS_MKDIR:
-    esp_under_phys_base(f, 1);
-    
-    sys_mkdir (*((int **)f->esp + 1), f);
+    name = copy_in_string ((const char *) args[0]);
+    sys_mkdir (name, f);
+    palloc_free_page (name);
     break;
   case SYS_READDIR:
-    esp_under_phys_base(f, 2);
-
-    sys_readdir (*((int *)f->esp + 1),*((int**)f->esp + 2), f);
+    sys_readdir (args[0], (char *) args[1], f);
     break;
   case SYS_ISDIR:
-    esp_under_phys_base(f, 1);
-
-    sys_isdir (*((int *)f->esp + 1), f);
+    sys_isdir (args[0], f);
     break;
   case SYS_INUMBER:
-    esp_under_phys_base(f, 1);
-
-    sys_inumber (*((int *)f->esp + 1), f);
+    sys_inumber (args[0], f);
+    break;
+  case SYS_READV:
+    check_fd(args[0], -1, f)
+    sys_readv (args[0], (const struct iovec *) args[1], args[2], f);
     break;
+  case SYS_WRITEV:
+    check_fd(args[0], -1, f)
+    sys_writev (args[0], (const struct iovec *) args[1], args[2], f);
+    break;
+#ifdef VM
+  case SYS_FORK:
+    sys_fork (f);
+    break;
+#endif
   }
 }
 
+/* Copies the null-terminated string at user address USTR into a
+   new page, which the caller must free with palloc_free_page().
+   Kills the process if USTR is not a valid user string or does
+   not fit in a page. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+
+  if (kstr == NULL)
+    sys_exit(-1);
+  if (!copy_str_from_user (kstr, ustr, PGSIZE)){
+    palloc_free_page (kstr);
+    sys_exit(-1);
+  }
+  return kstr;
+}
 
 static void
 sys_halt (void)
@@ -160,17 +232,11 @@ void
 sys_exit (int status)
 {
   struct thread *t = thread_current();
-  int fd;
   
   t->exit_code = status;
   t->end = true;
 
-  for (fd=0; fd < t->fd_num; fd++){ // close all open fd
-    if (t->fd_list[fd] != NULL){
-      file_close(t->fd_list[fd]);
-      t->fd_list[fd] = 0;
-    }
-  }
+  fd_table_destroy (&t->fds); // close all open fd
   printf("%s: exit(%d)\n", t->process_name, status);
 
   sema_up (&t->wait_this);
@@ -230,14 +296,14 @@ sys_open (void *file_, struct intr_frame *f)
   }
   else{
     struct thread *t = thread_current();
-    if (t->fd_num >= FD_MAX){
-        PANIC("FD_MAX is too small\n");
+    int fd = fd_alloc (&t->fds, file);
+    if (fd < 0){
+      file_close (file);
       f->eax = -1;
       return -1;
     }
-    f->eax = t->fd_num;
-    (t->fd_list)[(t->fd_num)++] = file;
-    return f->eax;
+    f->eax = fd;
+    return fd;
   }
 }
 
@@ -245,15 +311,14 @@ static int
 sys_filesize (int fd, struct intr_frame *f)
 {
   int size;
-  struct thread *t = thread_current();
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
 
-  ASSERT (fd >= 0 && fd < FD_MAX);
-  if (t->fd_list[fd] == NULL){
+  if (file == NULL){
     f->eax = 0;
     return 0;
   }
   else{
-    size = file_length (t->fd_list[fd]);
+    size = file_length (file);
     f->eax = size;
     return size;
   }
@@ -262,26 +327,24 @@ sys_filesize (int fd, struct intr_frame *f)
 static void
 sys_seek (int fd, unsigned position, struct intr_frame *f UNUSED)
 {
-  struct thread *t = thread_current();
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
   
-  ASSERT (fd >= 0 && fd < FD_MAX);
-  if (t->fd_list[fd] != NULL)
-    file_seek (t->fd_list[fd], position);
+  if (file != NULL)
+    file_seek (file, position);
 }
 
 static unsigned
 sys_tell (int fd, struct intr_frame *f)
 {
-  struct thread *t = thread_current();
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
   unsigned position;
   
-  ASSERT (fd >= 0 && fd < FD_MAX);
-  if (t->fd_list[fd] == NULL){
+  if (file == NULL){
     f->eax = 0;
     return 0;
   }
   else{
-    position = file_tell (t->fd_list[fd]);
+    position = file_tell (file);
     f->eax = position;
     return position;
   }
@@ -292,34 +355,29 @@ sys_close (int fd, struct intr_frame *f UNUSED)
 {
   struct thread *t = thread_current();
   
-  ASSERT (fd >= 0 && fd < FD_MAX);
-  if (t->fd_list[fd] != NULL){
-    file_close (t->fd_list[fd]);
-//    printf("reach here\n");
-    t->fd_list[fd]=NULL;
-//    printf("reach here2\n");
-  }
+  file_close (fd_remove (&t->fds, fd));
 }
 
 static int
 sys_write (int fd, void *buffer_, unsigned size, struct intr_frame *f)
 {
   char *buffer = (char*)buffer_;
-  ASSERT (fd >= 0 && fd < FD_MAX);
 //  printf("---------------------\n%d, %s, %d---------------------\n", fd, buffer, size);
  if (fd == 1){
-    putbuf(buffer, size);
+    write_console (buffer, size);
     f->eax = size;
   }
   else{
-    struct thread *t = thread_current();
-    if (t->fd_list[fd] == NULL){
+    struct file *file = fd_lookup (&thread_current ()->fds, fd);
+    if (file == NULL){
       f->eax = -1;
     }
     else{
-      if(get_isdir(get_finode(t->fd_list[fd])))
+      if(get_isdir(get_finode(file)))
         return f->eax = -1; 
-      f->eax = file_write (t->fd_list[fd], buffer_, size); 
+      pin_buffer (buffer_, size, false);
+      f->eax = file_write (file, buffer_, size); 
+      unpin_buffer (buffer_, size);
     }
   }
   return f->eax;
@@ -328,23 +386,50 @@ sys_write (int fd, void *buffer_, unsigned size, struct intr_frame *f)
 static int
 sys_read (int fd, void *buffer_, unsigned size, struct intr_frame *f)
 {
-  unsigned i;
   char *buffer = (char*)buffer_;
 
-  ASSERT (fd >= 0 && fd < FD_MAX);
-  if (fd == 0){
-    for (i=0; i<size; i++)
-      buffer[i] = input_getc();
-  }
+  if (fd == 0)
+    f->eax = read_console (buffer, size, true);
   else{
-    struct thread *t = thread_current();
-    if (t->fd_list[fd] == NULL)
+    struct file *file = fd_lookup (&thread_current ()->fds, fd);
+    if (file == NULL)
       f->eax = -1;
-    else
-      f->eax = file_read (t->fd_list[fd], buffer, size);
+    else{
+      pin_buffer (buffer, size, true);
+      f->eax = file_read (file, buffer, size);
+      unpin_buffer (buffer, size);
+    }
   }
   return f->eax;
 }
+#ifdef VM
+static mapid_t
+sys_mmap (int fd, void *addr, struct intr_frame *f)
+{
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
+
+  if (fd == 0 || fd == 1 || file == NULL
+      || get_isdir(get_finode(file)))
+    f->eax = MAP_FAILED;
+  else
+    f->eax = mmap_map (file, addr);
+  return f->eax;
+}
+
+static void
+sys_munmap (mapid_t mapping, struct intr_frame *f UNUSED)
+{
+  mmap_unmap (mapping);
+}
+
+static tid_t
+sys_fork (struct intr_frame *f)
+{
+  f->eax = process_fork (f);
+  return f->eax;
+}
+#endif
+
 static bool sys_chdir(const char *dir, struct intr_frame *f)
 {
     return f->eax = my_chdir(dir);
@@ -357,30 +442,282 @@ static bool sys_mkdir(const char *dir, struct intr_frame *f)
 
     return f->eax = my_mkdir(dir,0);
 }
-static bool sys_readdir(int fd, char *name, struct intr_frame *f)
+static bool sys_readdir(int fd, char *uname, struct intr_frame *f)
 {
+    char name[NAME_MAX + 1];
     bool success;
-    struct thread *t= thread_current();
-    if(t->fd_list[fd] ==NULL)
+    struct file *file = fd_lookup (&thread_current ()->fds, fd);
+    if(file ==NULL)
         return f->eax= false;
-    if(!get_isdir(get_finode(t->fd_list[fd])))
+    if(!get_isdir(get_finode(file)))
         return f->eax = false;
     
-    success = dir_readdir((struct dir*)t->fd_list[fd], name);
+    success = dir_readdir((struct dir*)file, name);
+    if (success && !copy_to_user (uname, name, strlen (name) + 1))
+        sys_exit(-1);
 
     return f->eax = success;
 }
 static bool sys_isdir(int fd, struct intr_frame *f)
 {
-    struct thread *t= thread_current();
-    if(t->fd_list[fd] ==NULL)
+    struct file *file = fd_lookup (&thread_current ()->fds, fd);
+    if(file ==NULL)
         return f->eax= false;
-    return f->eax = get_isdir(get_finode(t->fd_list[fd]));
+    return f->eax = get_isdir(get_finode(file));
 }
 static int sys_inumber(int fd, struct intr_frame *f)
 {
-    struct thread *t= thread_current();
-    if(t->fd_list[fd] ==NULL)
+    struct file *file = fd_lookup (&thread_current ()->fds, fd);
+    if(file ==NULL)
         return f->eax= false;
-    return f->eax = get_sector(get_finode(t->fd_list[fd]));
+    return f->eax = get_sector(get_finode(file));
+}
+
+/* Copies the IOVCNT-entry iovec array at user address UIOV into
+   a new kernel array, stores it in *IOVP, and validates every user
+   buffer it describes, all up front, so that the transfer itself
+   runs without further checks.  The caller must free *IOVP.  Kills
+   the process if the array is not readable or a buffer reaches
+   into kernel memory.  Returns false if IOVCNT is out of range,
+   the total length does not fit in an off_t, or memory runs out. */
+static bool
+copy_in_iov (const struct iovec *uiov, int iovcnt, struct iovec **iovp)
+{
+  struct iovec *iov = NULL;
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+  if (iovcnt > 0){
+    iov = malloc (iovcnt * sizeof *iov);
+    if (iov == NULL)
+      return false;
+    if (!copy_from_user (iov, uiov, iovcnt * sizeof *iov)){
+      free (iov);
+      sys_exit(-1);
+    }
+  }
+  for (i = 0; i < iovcnt; i++)
+    {
+      size_t len = iov[i].iov_len;
+
+      if (len == 0)
+        continue;
+      if (iov[i].iov_base == NULL || !is_user_range (iov[i].iov_base, len)){
+        free (iov);
+        sys_exit(-1);
+      }
+      if (len > INT_MAX - total){
+        free (iov);
+        return false;
+      }
+      total += len;
+    }
+  *iovp = iov;
+  return true;
+}
+
+static int
+sys_readv (int fd, const struct iovec *uiov, int iovcnt, struct intr_frame *f)
+{
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
+  struct iovec *iov;
+  int i;
+
+  if (!copy_in_iov (uiov, iovcnt, &iov)){
+    f->eax = -1;
+    return -1;
+  }
+  if (fd == 0){
+    /* Like read(), wait only for the first key, and stop as soon
+       as the keys waiting run out. */
+    f->eax = 0;
+    for (i = 0; i < iovcnt; i++){
+      size_t n = read_console (iov[i].iov_base, iov[i].iov_len,
+                               f->eax == 0);
+      f->eax += n;
+      if (n < iov[i].iov_len)
+        break;
+    }
+  }
+  else if (file == NULL)
+    f->eax = -1;
+  else if (!pin_iov (iov, iovcnt, true)){
+    free (iov);
+    sys_exit(-1);
+  }
+  else{
+    f->eax = file_readv (file, iov, iovcnt);
+    unpin_iov (iov, iovcnt);
+  }
+  free (iov);
+  return f->eax;
+}
+
+static int
+sys_writev (int fd, const struct iovec *uiov, int iovcnt, struct intr_frame *f)
+{
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
+  struct iovec *iov;
+  int i;
+
+  if (!copy_in_iov (uiov, iovcnt, &iov)){
+    f->eax = -1;
+    return -1;
+  }
+  if (fd == 1){
+    f->eax = 0;
+    for (i = 0; i < iovcnt; i++){
+      write_console (iov[i].iov_base, iov[i].iov_len);
+      f->eax += iov[i].iov_len;
+    }
+  }
+  else if (file == NULL)
+    f->eax = -1;
+  else if (get_isdir(get_finode(file)))
+    f->eax = -1;
+  else if (!pin_iov (iov, iovcnt, false)){
+    free (iov);
+    sys_exit(-1);
+  }
+  else{
+    f->eax = file_writev (file, iov, iovcnt);
+    unpin_iov (iov, iovcnt);
+  }
+  free (iov);
+  return f->eax;
+}
+
+/* Reads up to SIZE bytes from the keyboard into user buffer
+   UBUF and returns the number read, killing the process if UBUF
+   is not writable.  If no keys at all are buffered, waits for
+   one if WAIT is true and otherwise returns 0; if there are
+   keys, returns what is there, which may be fewer than SIZE
+   bytes. */
+static size_t
+read_console (void *ubuf, size_t size, bool wait)
+{
+  uint8_t chunk[64];
+  size_t n;
+
+  if (size > sizeof chunk)
+    size = sizeof chunk;
+  n = wait ? input_read (chunk, size) : input_try_read (chunk, size);
+  if (!copy_to_user (ubuf, chunk, n))
+    sys_exit(-1);
+  return n;
+}
+
+/* Writes the SIZE bytes in user buffer UBUF to the console,
+   killing the process if UBUF is not readable.  The bytes go
+   through a buffer on the stack, a chunk at a time, so that a
+   bad buffer cannot fault while the console lock is held. */
+static void
+write_console (const void *ubuf, size_t size)
+{
+  const uint8_t *src = ubuf;
+  uint8_t chunk[64];
+
+  while (size > 0)
+    {
+      size_t n = size < sizeof chunk ? size : sizeof chunk;
+
+      if (!copy_from_user (chunk, src, n))
+        sys_exit(-1);
+      putbuf ((const char *) chunk, n);
+      src += n;
+      size -= n;
+    }
+}
+#ifdef VM
+
+/* Pins every page of the SIZE bytes of user memory at BUFFER,
+   so that file system code never faults on them while it holds
+   buffer cache locks.  Returns false, possibly leaving some pages
+   pinned, if part of the buffer is not mapped or, if WILL_WRITE
+   is true, is read-only. */
+static bool
+pin_range (const void *buffer, size_t size, bool will_write)
+{
+  const uint8_t *end = (const uint8_t *) buffer + size;
+  const uint8_t *upage;
+
+  if (!is_user_range (buffer, size))
+    return false;
+  for (upage = pg_round_down (buffer); upage < end; upage += PGSIZE)
+    if (!page_lock (upage, will_write))
+      return false;
+  return true;
+}
+
+/* Unpins the pages of the SIZE bytes at BUFFER that the current
+   thread has pinned. */
+static void
+unpin_buffer (const void *buffer, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) buffer + size;
+  const uint8_t *upage;
+
+  for (upage = pg_round_down (buffer); upage < end; upage += PGSIZE)
+    page_unlock (upage);
+}
+
+#else
+
+/* Without virtual memory, user pages stay mapped once loaded, so
+   there is nothing to pin: just checks, one page at a time, that
+   all SIZE bytes at BUFFER are mapped and, if WILL_WRITE is true,
+   writable. */
+static bool
+pin_range (const void *buffer, size_t size, bool will_write)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  const uint8_t *end = (const uint8_t *) buffer + size;
+  const uint8_t *upage;
+
+  if (!is_user_range (buffer, size))
+    return false;
+  for (upage = pg_round_down (buffer); upage < end; upage += PGSIZE)
+    if (pagedir_get_page (pd, upage) == NULL
+        || (will_write && !pagedir_is_writable (pd, upage)))
+      return false;
+  return true;
+}
+#endif
+
+/* Pins the SIZE bytes at BUFFER, killing the process if they
+   are not validly mapped. */
+static void
+pin_buffer (const void *buffer, size_t size, bool will_write)
+{
+  if (!pin_range (buffer, size, will_write)){
+    unpin_buffer (buffer, size);
+    sys_exit(-1);
+  }
+}
+
+/* Pins the IOVCNT buffers in IOV.  Returns false, with nothing
+   left pinned, if they are not validly mapped. */
+static bool
+pin_iov (const struct iovec *iov, int iovcnt, bool will_write)
+{
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    if (!pin_range (iov[i].iov_base, iov[i].iov_len, will_write)){
+      unpin_iov (iov, iovcnt);
+      return false;
+    }
+  return true;
+}
+
+/* Unpins the IOVCNT buffers in IOV. */
+static void
+unpin_iov (const struct iovec *iov, int iovcnt)
+{
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    unpin_buffer (iov[i].iov_base, iov[i].iov_len);
 }
@@ -0,0 +1,95 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Defined in usercopy.S. */
+bool user_copy (void *dst, const void *src, size_t size);
+int user_strlcpy (char *dst, const char *src, size_t size);
+extern const char user_copy_insn[], user_copy_insn2[], user_copy_fixup[];
+extern const char user_strlcpy_insn[], user_strlcpy_fixup[];
+
+/* Exception table: each instruction in usercopy.S that may fault
+   on a user address, and where to resume if it does. */
+struct fixup
+  {
+    const void *insn;           /* Faulting instruction. */
+    const void *fixup;          /* Recovery code. */
+  };
+
+static const struct fixup fixups[] =
+  {
+    {user_copy_insn, user_copy_fixup},
+    {user_copy_insn2, user_copy_fixup},
+    {user_strlcpy_insn, user_strlcpy_fixup},
+  };
+
+/* Returns true if the SIZE bytes at UADDR lie entirely in user
+   virtual memory. */
+bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if USRC is not a valid
+   user range, in which case DST may have been partly written. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && user_copy (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if UDST is not a valid
+   writable user range, in which case a prefix of it may have been
+   written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && user_copy (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE bytes at DST.  Returns true if successful, false if
+   USRC is not a valid user string or is too long to fit, with its
+   null terminator, in SIZE bytes. */
+bool
+copy_str_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t limit;
+  int length;
+
+  if (!is_user_vaddr (usrc))
+    return false;
+
+  /* Don't let the copy run off the end of user memory. */
+  limit = (const char *) PHYS_BASE - usrc;
+  if (size > limit)
+    size = limit;
+
+  length = user_strlcpy (dst, usrc, size);
+  return length >= 0 && (size_t) length < size;
+}
+
+/* Called by the page fault handler for a kernel fault on a user
+   address.  If the fault was in one of the copy routines, arranges
+   for it to return failure and returns true.  Otherwise, returns
+   false: the fault is a kernel bug or a direct access to user
+   memory. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof fixups / sizeof *fixups; i++)
+    if ((const void *) f->eip == fixups[i].insn)
+      {
+        f->eip = (void (*) (void)) fixups[i].fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,23 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+
+/* Copying to and from user memory.
+
+   These check only that the user range lies below PHYS_BASE,
+   then simply perform the copy.  A page fault on an unmapped or
+   read-only user page is turned into a false return by
+   uaccess_fixup(), called from the page fault handler, so there
+   is no need to probe the range page by page beforehand. */
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+bool copy_str_from_user (char *dst, const char *usrc, size_t size);
+bool is_user_range (const void *uaddr, size_t size);
+
+bool uaccess_fixup (struct intr_frame *);
+
+#endif /* userprog/uaccess.h */
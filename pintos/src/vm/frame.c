@@ -0,0 +1,175 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "vm/page.h"
+
+/* Frame table: one entry per page of the user pool. */
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* Serializes scans of the frame table. */
+static struct lock scan_lock;
+
+/* Free frames, and the lock that protects the list. */
+static struct list free_frames;
+static struct lock free_lock;
+
+/* Clock hand for eviction. */
+static size_t hand;
+
+/* Number of frames taken from one page to give to another. */
+static long long evict_cnt;
+
+/* Gives free frame F, which the caller has locked, to PAGE, or
+   to shared text if PAGE is null. */
+static void
+frame_claim (struct frame *f, struct page *page)
+{
+  ASSERT (list_empty (&f->pages));
+
+  if (page != NULL)
+    list_push_back (&f->pages, &page->frame_elem);
+  f->shared = page == NULL;
+}
+
+/* Claims every page of the user pool for the frame table. */
+void
+frame_init (void)
+{
+  void *base;
+
+  lock_init (&scan_lock);
+  list_init (&free_frames);
+  lock_init (&free_lock);
+
+  frames = malloc (sizeof *frames * init_ram_pages);
+  if (frames == NULL)
+    PANIC ("out of memory allocating frame table");
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL)
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+      f->shared = false;
+      list_push_back (&free_frames, &f->free_elem);
+    }
+}
+
+/* Allocates a frame for PAGE and returns it locked, evicting
+   some other page if memory is full.  If PAGE is null, the frame
+   is for a shared text page and is never chosen for eviction.
+   Returns a null pointer if every frame is pinned or paging out
+   fails. */
+struct frame *
+frame_alloc_and_lock (struct page *page)
+{
+  struct frame *f = NULL;
+  size_t i;
+
+  /* Take a free frame if there is one.  Nobody else can claim it
+     once it is off the list, but a thread whose page used to be
+     in it may still hold its lock briefly in frame_lock(). */
+  lock_acquire (&free_lock);
+  if (!list_empty (&free_frames))
+    f = list_entry (list_pop_front (&free_frames), struct frame, free_elem);
+  lock_release (&free_lock);
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      frame_claim (f, page);
+      return f;
+    }
+
+  /* Otherwise run the clock: give each frame whose pages were
+     accessed since the hand last passed a second chance, and
+     evict the first one whose pages were not.  Two sweeps are
+     enough for every accessed bit to have been cleared.  Free
+     frames are left to the free list. */
+  lock_acquire (&scan_lock);
+  for (i = 0; i < frame_cnt * 2; i++)
+    {
+      f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      /* We may already hold some frames, say to pin the earlier
+         pages of a buffer that spans several pages. */
+      if (f->shared || lock_held_by_current_thread (&f->lock)
+          || !lock_try_acquire (&f->lock))
+        continue;
+      if (list_empty (&f->pages) || page_accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+
+      /* Page out without holding up other scans; F stays locked
+         so its owner waits for us before faulting it back in. */
+      lock_release (&scan_lock);
+      if (!page_out (f))
+        {
+          lock_release (&f->lock);
+          return NULL;
+        }
+      evict_cnt++;
+      frame_claim (f, page);
+      return f;
+    }
+
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Locks PAGE's frame, if it has one, pinning it in memory.  If
+   the frame is being paged out, waits for that to finish, after
+   which PAGE no longer has a frame. */
+void
+frame_lock (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f != p->frame)
+        {
+          lock_release (&f->lock);
+          ASSERT (p->frame == NULL);
+        }
+    }
+}
+
+/* Unlocks frame F, allowing it to be evicted again. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Returns locked frame F to the free pool and unlocks it.  Any
+   pages still on F must have been given up by their owners. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  list_init (&f->pages);
+  f->shared = false;
+  lock_acquire (&free_lock);
+  list_push_back (&free_frames, &f->free_elem);
+  lock_release (&free_lock);
+  lock_release (&f->lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu user frames, %lld evictions\n", frame_cnt, evict_cnt);
+}
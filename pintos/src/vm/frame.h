@@ -0,0 +1,34 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/synch.h"
+
+struct page;
+
+/* A physical frame of user memory.
+
+   Every page of the user pool is claimed by the frame table at
+   boot.  A frame is free when PAGES is empty and it is not
+   SHARED, and then it is on the free frame list.  PAGES normally holds a single page; after a fork it
+   holds one page per process sharing the frame copy-on-write.
+   Holding LOCK pins the frame: it cannot be evicted, and PAGES
+   cannot change under the holder. */
+struct frame
+  {
+    struct lock lock;           /* Pins the frame. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Private pages mapping the frame. */
+    bool shared;                /* Holds shared text?  Never evicted. */
+    struct list_elem free_elem; /* Element in the free frame list. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc_and_lock (struct page *);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_free (struct frame *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,134 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+static struct mmap *mmap_lookup (mapid_t);
+static void unmap (struct mmap *);
+
+/* Maps FILE into the current process's address space starting
+   at user page ADDR.  The pages are only recorded here; each one
+   is read from the file the first time it is touched.  Returns
+   the new mapping's identifier, or MAP_FAILED if FILE is empty,
+   ADDR is null or misaligned, or the range would overlap memory
+   that is already mapped. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mmap *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length == 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      void *upage = (uint8_t *) addr + i * PGSIZE;
+      if (!is_user_vaddr (upage) || page_lookup (upage) != NULL
+          || pagedir_get_page (t->pagedir, upage) != NULL)
+        {
+          free (m);
+          return MAP_FAILED;
+        }
+    }
+
+  /* Use our own handle so that closing the descriptor does not
+     tear down the mapping. */
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      if (page_add_file ((uint8_t *) addr + ofs, m->file, ofs, read_bytes,
+                         true, true) == NULL)
+        {
+          m->page_cnt = i;
+          unmap (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mmaps, &m->elem);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping MAPPING, writing back
+   any pages that were modified.  Does nothing if there is no such
+   mapping. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct mmap *m = mmap_lookup (mapping);
+  if (m != NULL)
+    {
+      list_remove (&m->elem);
+      unmap (m);
+    }
+}
+
+/* Unmaps every mapping of the current process.  Called when the
+   process exits. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mmaps))
+    unmap (list_entry (list_pop_front (&t->mmaps), struct mmap, elem));
+}
+
+/* Returns the current process's mapping with identifier MAPPING,
+   or a null pointer if there is none. */
+static struct mmap *
+mmap_lookup (mapid_t mapping)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mmaps); e != list_end (&t->mmaps);
+       e = list_next (e))
+    {
+      struct mmap *m = list_entry (e, struct mmap, elem);
+      if (m->id == mapping)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages, writing back dirty ones, then closes its
+   file and frees it.  M must not be in any list. */
+static void
+unmap (struct mmap *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      struct page *p = page_lookup ((uint8_t *) m->addr + i * PGSIZE);
+      if (p != NULL)
+        page_remove (p);
+    }
+  file_close (m->file);
+  free (m);
+}
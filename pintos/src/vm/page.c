@@ -0,0 +1,576 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* Limit on the size of a user stack, in pages. */
+size_t stack_page_limit = STACK_MAX_PAGES;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void page_destructor (struct hash_elem *, void *aux);
+static struct page *page_for_addr (const void *uaddr);
+static void page_release (struct page *);
+static bool page_load (struct page *);
+static bool page_load_shared (struct page *);
+static bool page_map (struct page *, bool dirty);
+static bool page_unshare (struct page *);
+
+/* Initializes supplemental page table PAGES.
+   Returns false if memory allocation fails. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every entry of supplemental page table PAGES, which must
+   belong to the current process, along with the frames and swap
+   slots that hold them.  Afterward no user page remains mapped in
+   the process's page directory. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, page_destructor);
+}
+
+/* Records that user page UPAGE of the current process is backed
+   by READ_BYTES bytes of FILE starting at offset OFS, followed by
+   zeros up to the end of the page.  FILE may be null if
+   READ_BYTES is 0, for a page that is all zeros.  Nothing is read
+   until the page is first touched.  If WRITE_BACK is true, modified data is
+   written back to FILE when the page is evicted or removed;
+   otherwise it goes to swap.
+   Returns the new page, or a null pointer if UPAGE is already in
+   the page table or memory allocation fails. */
+struct page *
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable, bool write_back)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->upage = upage;
+  p->writable = writable;
+  p->thread = t;
+  p->frame = NULL;
+  p->sector = (block_sector_t) -1;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->write_back = write_back;
+  p->shared = NULL;
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns the current process's page that contains user virtual
+   address UADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Returns the current process's page that contains UADDR.  If
+   there is none but UADDR is a stack access, one at or just below
+   the user stack pointer and within stack_page_limit pages of the
+   top of user memory, adds a zero page there to grow the stack.
+   Otherwise returns a null pointer. */
+static struct page *
+page_for_addr (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p == NULL && is_user_vaddr (uaddr))
+    {
+      /* PUSHA can fault 32 bytes below the stack pointer. */
+      uintptr_t esp = (uintptr_t) thread_current ()->user_esp;
+      if ((uintptr_t) uaddr >= esp - 32
+          && pg_no (PHYS_BASE) - pg_no (uaddr) <= stack_page_limit)
+        p = page_add_file (pg_round_down (uaddr), NULL, 0, 0, true, false);
+    }
+  return p;
+}
+
+/* Unmaps page P from the current process and frees it.  If P is
+   resident and was modified, its contents are first written back
+   to its file, if it has WRITE_BACK set. */
+void
+page_remove (struct page *p)
+{
+  struct thread *t = thread_current ();
+
+  page_release (p);
+  hash_delete (&t->pages, &p->elem);
+  free (p);
+}
+
+/* Brings in the page containing FAULT_ADDR, which the current
+   process just faulted on, growing the stack if it is a stack
+   access.  Returns true if successful, false if FAULT_ADDR is not
+   part of the process's address space or the page cannot be
+   loaded. */
+bool
+page_in (void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  bool success;
+
+  if (t->pagedir == NULL)
+    return false;
+
+  p = page_for_addr (fault_addr);
+  if (p == NULL)
+    return false;
+
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      if (!page_load (p))
+        return false;
+      frame_unlock (p->frame);
+      return true;
+    }
+
+  /* Still resident: a failed page_out() unmapped it but kept
+     the frame.  Its data may have been modified. */
+  success = page_map (p, true);
+  frame_unlock (p->frame);
+  return success;
+}
+
+/* Handles a write by the current process to FAULT_ADDR, which
+   is mapped read-only.  If the page is writable but shares its
+   frame copy-on-write, gives it a frame of its own.  Returns true
+   if the write should be retried, false if the page really is
+   read-only or memory is exhausted. */
+bool
+page_copy_on_write (void *fault_addr)
+{
+  struct page *p = page_lookup (fault_addr);
+  bool success;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      /* Evicted in the meantime.  The retry faults it back in. */
+      return true;
+    }
+  success = page_unshare (p);
+  frame_unlock (p->frame);
+  return success;
+}
+
+/* Evicts the pages held in frame F, which the caller must have
+   locked, writing the frame to its file or to swap if it was
+   modified.  The pages may belong to any process.  Returns true
+   if successful, in which case F holds no pages. */
+bool
+page_out (struct frame *f)
+{
+  block_sector_t sector = (block_sector_t) -1;
+  struct page *first;
+  struct list_elem *e;
+  bool dirty = false;
+  bool ok;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!list_empty (&f->pages));
+
+  /* Unmap the pages first, so that their owners fault, and wait
+     for the frame lock, instead of modifying the frame while it
+     is being written. */
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      pagedir_clear_page (p->thread->pagedir, p->upage);
+      if (pagedir_is_dirty (p->thread->pagedir, p->upage))
+        dirty = true;
+    }
+
+  /* Mapped-file pages are never shared, so FIRST is the only page
+     if it has WRITE_BACK set. */
+  first = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (!dirty)
+    ok = true;
+  else if (first->write_back)
+    ok = file_write_at (first->file, f->base, first->read_bytes, first->ofs)
+         == (off_t) first->read_bytes;
+  else
+    {
+      sector = swap_out (f->base);
+      ok = sector != (block_sector_t) -1;
+    }
+  if (!ok)
+    return false;
+
+  /* Every sharer refers to the same swap slot. */
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      if (sector != (block_sector_t) -1)
+        {
+          if (p != first)
+            swap_dup (sector);
+          p->sector = sector;
+        }
+      p->frame = NULL;
+    }
+  return true;
+}
+
+/* Returns true if any page held in frame F, which the caller
+   must have locked, was accessed since the last call for F, and
+   clears the accessed bits. */
+bool
+page_accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Copies the address space of PARENT, which must be blocked
+   waiting for the current thread, into the current process.
+   Resident private pages are shared copy-on-write, with both
+   processes mapping the frame read-only.  Swapped-out pages share
+   their swap slot, and pages not yet loaded are simply described
+   again.  Pages of memory-mapped files are not inherited.
+   The current thread's open_file must already be its own handle
+   on PARENT's executable, from which every other file-backed page
+   comes.  Returns false if memory allocation fails. */
+bool
+page_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, elem);
+      struct page *p;
+
+      if (pp->write_back)
+        continue;
+      p = page_add_file (pp->upage, pp->file != NULL ? t->open_file : NULL,
+                         pp->ofs, pp->read_bytes, pp->writable, false);
+      if (p == NULL)
+        return false;
+
+      /* Shared text is mapped again on first touch. */
+      if (pp->shared != NULL)
+        continue;
+
+      frame_lock (pp);
+      if (pp->frame != NULL)
+        {
+          struct frame *f = pp->frame;
+
+          if (!pagedir_set_page (t->pagedir, p->upage, f->base, false))
+            {
+              frame_unlock (f);
+              return false;
+            }
+          if (pagedir_is_dirty (parent->pagedir, pp->upage))
+            pagedir_set_dirty (t->pagedir, p->upage, true);
+          pagedir_set_writable (parent->pagedir, pp->upage, false);
+          p->frame = f;
+          list_push_back (&f->pages, &p->frame_elem);
+          frame_unlock (f);
+        }
+      else if (pp->sector != (block_sector_t) -1)
+        {
+          swap_dup (pp->sector);
+          p->sector = pp->sector;
+        }
+    }
+  return true;
+}
+
+/* Brings in the current process's page that contains UADDR, if
+   necessary, and pins it in memory so that the kernel can access
+   it without faulting.  If WILL_WRITE is true, the page must be
+   writable.  Grows the stack as page_in() does.  Does nothing if
+   the current thread already has the page pinned.  Returns true
+   if successful, false if UADDR is not validly mapped.  Release
+   the page with page_unlock(). */
+bool
+page_lock (const void *uaddr, bool will_write)
+{
+  struct page *p = page_for_addr (uaddr);
+
+  if (p == NULL || (will_write && !p->writable))
+    return false;
+  if (p->frame != NULL && lock_held_by_current_thread (&p->frame->lock))
+    return true;
+
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      if (!page_load (p))
+        return false;
+    }
+  else if (pagedir_get_page (p->thread->pagedir, p->upage) == NULL
+           && !page_map (p, true))
+    {
+      frame_unlock (p->frame);
+      return false;
+    }
+
+  /* A write fault on a pinned page would deadlock, so break any
+     copy-on-write sharing now. */
+  if (will_write && !page_unshare (p))
+    {
+      frame_unlock (p->frame);
+      return false;
+    }
+  return true;
+}
+
+/* Unpins the page containing UADDR, if the current thread has it
+   pinned with page_lock(). */
+void
+page_unlock (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p != NULL && p->frame != NULL
+      && lock_held_by_current_thread (&p->frame->lock))
+    frame_unlock (p->frame);
+}
+
+/* Releases page P's hold on its frame or swap slot, freeing them
+   if no other process shares them.  P must belong to the current
+   process.  Modified data is first written back to P's file if
+   it has WRITE_BACK set. */
+static void
+page_release (struct page *p)
+{
+  struct thread *t = thread_current ();
+
+  if (p->shared != NULL)
+    {
+      pagedir_clear_page (t->pagedir, p->upage);
+      share_put (p->shared);
+      return;
+    }
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+
+      if (p->write_back && pagedir_is_dirty (t->pagedir, p->upage))
+        file_write_at (p->file, f->base, p->read_bytes, p->ofs);
+      pagedir_clear_page (t->pagedir, p->upage);
+      list_remove (&p->frame_elem);
+      p->frame = NULL;
+      if (list_empty (&f->pages))
+        frame_free (f);
+      else
+        frame_unlock (f);
+    }
+  else if (p->sector != (block_sector_t) -1)
+    swap_free (p->sector);
+}
+
+/* Reads nonresident page P into a fresh frame and maps it.
+   Read-only pages of a file are executable text and are shared
+   with every other process running the same executable.
+   Returns true if successful, with P's frame locked. */
+static bool
+page_load (struct page *p)
+{
+  struct frame *f;
+
+  ASSERT (p->frame == NULL);
+
+  if (!p->writable && p->file != NULL)
+    return page_load_shared (p);
+
+  f = frame_alloc_and_lock (p);
+  if (f == NULL)
+    return false;
+  p->frame = f;
+
+  if (p->sector != (block_sector_t) -1)
+    {
+      /* The frame holds the only copy of the data once the slot
+         is freed, so mark the page dirty to send it back to swap
+         if it is evicted.  Keep the slot until the page is mapped,
+         so that P still has its data if mapping fails. */
+      swap_in (p->sector, f->base);
+      if (page_map (p, true))
+        {
+          swap_free (p->sector);
+          p->sector = (block_sector_t) -1;
+          return true;
+        }
+    }
+  else if (p->read_bytes == 0
+           || file_read_at (p->file, f->base, p->read_bytes, p->ofs)
+              == (off_t) p->read_bytes)
+    {
+      memset ((uint8_t *) f->base + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      if (page_map (p, false))
+        return true;
+    }
+
+  p->frame = NULL;
+  frame_free (f);
+  return false;
+}
+
+/* Maps read-only text page P onto the frame shared by all
+   processes running the same executable, reading it in if this
+   is the first of them to touch it.  Returns true if successful,
+   with the frame locked. */
+static bool
+page_load_shared (struct page *p)
+{
+  struct shared_page *sp;
+
+  sp = share_get (p->file, p->ofs, p->read_bytes);
+  if (sp == NULL)
+    return false;
+  p->frame = sp->frame;
+  p->shared = sp;
+  frame_lock (p);
+  if (!page_map (p, false))
+    {
+      frame_unlock (p->frame);
+      p->frame = NULL;
+      p->shared = NULL;
+      share_put (sp);
+      return false;
+    }
+  return true;
+}
+
+/* Maps resident page P into its owner's page directory, marking
+   it dirty if DIRTY is true.  A page that shares its frame
+   copy-on-write is mapped read-only.  Returns false if memory
+   for a page table cannot be allocated. */
+static bool
+page_map (struct page *p, bool dirty)
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool writable = p->writable && list_size (&p->frame->pages) == 1;
+
+  if (!pagedir_set_page (pd, p->upage, p->frame->base, writable))
+    return false;
+  if (dirty)
+    pagedir_set_dirty (pd, p->upage, true);
+  return true;
+}
+
+/* Gives page P, whose frame the caller must have locked, a frame
+   of its own if it shares one copy-on-write, and maps it
+   writable.  Returns true if successful, with P's new frame
+   locked and its old one unlocked. */
+static bool
+page_unshare (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+  struct frame *old = p->frame;
+  struct frame *new;
+
+  if (list_size (&old->pages) == 1)
+    {
+      /* Every other sharer has already gone. */
+      pagedir_set_writable (pd, p->upage, true);
+      return true;
+    }
+
+  /* OLD stays locked, so that no sharer can fault or evict it
+     while we copy it.  frame_alloc_and_lock() passes over frames
+     we hold, so it will not pick OLD. */
+  list_remove (&p->frame_elem);
+  new = frame_alloc_and_lock (p);
+  if (new == NULL)
+    {
+      list_push_back (&old->pages, &p->frame_elem);
+      return false;
+    }
+  memcpy (new->base, old->base, PGSIZE);
+  pagedir_clear_page (pd, p->upage);
+  p->frame = new;
+  frame_unlock (old);
+  return page_map (p, true);
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *p = hash_entry (a, struct page, elem);
+  const struct page *q = hash_entry (b, struct page, elem);
+  return p->upage < q->upage;
+}
+
+/* Frees page E during page_table_destroy(). */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  page_release (p);
+  free (p);
+}
@@ -0,0 +1,70 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+struct shared_page;
+struct thread;
+
+/* A page of user virtual memory that is brought in on demand.
+
+   Every page a process may fault in has one of these in the
+   `pages' hash table of its struct thread, keyed by user virtual
+   address.  The page is resident when FRAME is non-null.  A
+   resident page may be evicted by any thread that needs a frame,
+   after which it is read back from SECTOR in swap if it was
+   written out there, or else from FILE or as zeros.
+
+   After a fork, a resident private page shares its frame with
+   the child's copy of it.  Both are mapped read-only until one
+   of them writes, which gives the writer its own frame. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    bool writable;              /* May the user process write it? */
+    struct thread *thread;      /* Owning thread. */
+    struct frame *frame;        /* Frame holding the page, or NULL. */
+    struct list_elem frame_elem; /* Element in FRAME's page list. */
+    block_sector_t sector;      /* First swap sector, or -1. */
+
+    /* Backing store. */
+    struct file *file;          /* File to read from, NULL if none. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes read from FILE, rest zeroed. */
+    bool write_back;            /* Write dirty data back to FILE? */
+    struct shared_page *shared; /* Shared text frame, if mapped from one. */
+
+    struct hash_elem elem;      /* Element in thread's page table. */
+  };
+
+/* Default limit on the size of a user stack, in pages (8 MB). */
+#define STACK_MAX_PAGES 2048
+
+/* Limit on the size of a user stack, in pages.  Set by -sl. */
+extern size_t stack_page_limit;
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+struct page *page_add_file (void *upage, struct file *, off_t ofs,
+                            size_t read_bytes, bool writable,
+                            bool write_back);
+struct page *page_lookup (const void *uaddr);
+void page_remove (struct page *);
+bool page_in (void *fault_addr);
+bool page_copy_on_write (void *fault_addr);
+bool page_out (struct frame *);
+bool page_accessed_recently (struct frame *);
+bool page_fork (struct thread *parent);
+
+bool page_lock (const void *uaddr, bool will_write);
+void page_unlock (const void *uaddr);
+
+#endif /* vm/page.h */
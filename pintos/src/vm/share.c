@@ -0,0 +1,166 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+
+/* Shared text pages, keyed by inode, offset, and read bytes. */
+static struct hash shared_pages;
+
+/* Protects shared_pages and the frame, loading and map_cnt
+   members of its entries. */
+static struct lock share_lock;
+
+static hash_hash_func shared_page_hash;
+static hash_less_func shared_page_less;
+
+/* Initializes the shared text page table. */
+void
+share_init (void)
+{
+  hash_init (&shared_pages, shared_page_hash, shared_page_less, NULL);
+  lock_init (&share_lock);
+}
+
+/* Returns the shared frame that holds the page at offset OFS of
+   executable FILE, whose first READ_BYTES bytes come from FILE
+   and the rest are zero.  If no process has it in memory yet, a
+   frame is allocated and read from FILE; other processes that
+   fault on the same page meanwhile wait for that read instead
+   of starting their own.  Shared frames are never evicted, so
+   the frame stays put until the last share_put().  The caller
+   must map the frame read-only and eventually release it with
+   share_put().
+   Returns a null pointer if memory allocation or the read
+   fails. */
+struct shared_page *
+share_get (struct file *file, off_t ofs, size_t read_bytes)
+{
+  struct shared_page key, *sp;
+  struct hash_elem *e;
+  struct frame *frame;
+
+  key.inode = file_get_inode (file);
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shared_pages, &key.elem);
+  if (e != NULL)
+    {
+      sp = hash_entry (e, struct shared_page, elem);
+      sp->map_cnt++;
+      while (sp->loading)
+        cond_wait (&sp->loaded, &share_lock);
+      if (sp->frame == NULL)
+        {
+          /* The read failed and SP is already out of the table.
+             The last process to give up on it frees it. */
+          if (--sp->map_cnt == 0)
+            free (sp);
+          sp = NULL;
+        }
+      lock_release (&share_lock);
+      return sp;
+    }
+
+  /* Insert the entry before reading the page, so that other
+     processes find it and wait, and read without holding
+     share_lock.  Keep the inode open, and unwritable, for as long
+     as any process maps the page. */
+  sp = malloc (sizeof *sp);
+  if (sp == NULL)
+    {
+      lock_release (&share_lock);
+      return NULL;
+    }
+  sp->inode = inode_reopen (key.inode);
+  inode_deny_write (sp->inode);
+  sp->ofs = ofs;
+  sp->read_bytes = read_bytes;
+  sp->frame = NULL;
+  sp->loading = true;
+  cond_init (&sp->loaded);
+  sp->map_cnt = 1;
+  hash_insert (&shared_pages, &sp->elem);
+  lock_release (&share_lock);
+
+  frame = frame_alloc_and_lock (NULL);
+  if (frame != NULL)
+    {
+      if (file_read_at (file, frame->base, read_bytes, ofs)
+          == (off_t) read_bytes)
+        {
+          memset ((uint8_t *) frame->base + read_bytes, 0,
+                  PGSIZE - read_bytes);
+          frame_unlock (frame);
+        }
+      else
+        {
+          frame_free (frame);
+          frame = NULL;
+        }
+    }
+
+  lock_acquire (&share_lock);
+  sp->frame = frame;
+  sp->loading = false;
+  cond_broadcast (&sp->loaded, &share_lock);
+  if (frame == NULL)
+    {
+      /* Take SP out of the table, so that the next fault tries
+         the read again. */
+      hash_delete (&shared_pages, &sp->elem);
+      inode_allow_write (sp->inode);
+      inode_close (sp->inode);
+      if (--sp->map_cnt == 0)
+        free (sp);
+      sp = NULL;
+    }
+  lock_release (&share_lock);
+  return sp;
+}
+
+/* Drops one mapping of SP.  Frees the frame when the last
+   process unmaps it. */
+void
+share_put (struct shared_page *sp)
+{
+  lock_acquire (&share_lock);
+  if (--sp->map_cnt == 0)
+    {
+      hash_delete (&shared_pages, &sp->elem);
+      lock_acquire (&sp->frame->lock);
+      frame_free (sp->frame);
+      inode_allow_write (sp->inode);
+      inode_close (sp->inode);
+      free (sp);
+    }
+  lock_release (&share_lock);
+}
+
+/* Returns a hash value for shared page E. */
+static unsigned
+shared_page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct shared_page *sp = hash_entry (e, struct shared_page, elem);
+  return hash_bytes (&sp->inode, sizeof sp->inode) ^ hash_int (sp->ofs);
+}
+
+/* Returns true if shared page A precedes shared page B. */
+static bool
+shared_page_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  const struct shared_page *sa = hash_entry (a, struct shared_page, elem);
+  const struct shared_page *sb = hash_entry (b, struct shared_page, elem);
+  if (sa->inode != sb->inode)
+    return sa->inode < sb->inode;
+  if (sa->ofs != sb->ofs)
+    return sa->ofs < sb->ofs;
+  return sa->read_bytes < sb->read_bytes;
+}
@@ -0,0 +1,35 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <hash.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct frame;
+struct inode;
+
+/* A read-only page of executable text, held in one frame that
+   every process running the same executable maps.  Entries are
+   kept in a global table keyed by inode, file offset, and the
+   number of bytes read from the file; two segments whose pages
+   start at the same offset but read different amounts get
+   different frames. */
+struct shared_page
+  {
+    struct inode *inode;        /* Executable's inode (we hold a reference). */
+    off_t ofs;                  /* Offset of the page in the inode. */
+    size_t read_bytes;          /* Bytes read from the inode; rest zero. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    bool loading;               /* Still being read in? */
+    struct condition loaded;    /* Signaled when LOADING becomes false. */
+    int map_cnt;                /* Number of processes mapping it. */
+    struct hash_elem elem;      /* Element in the shared page table. */
+  };
+
+void share_init (void);
+struct shared_page *share_get (struct file *, off_t ofs, size_t read_bytes);
+void share_put (struct shared_page *);
+
+#endif /* vm/share.h */
@@ -0,0 +1,119 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The swap device. */
+static struct block *swap_device;
+
+/* Used swap slots, one bit per page. */
+static struct bitmap *swap_bitmap;
+
+/* Number of pages referring to each used slot.  A slot is shared
+   when a copy-on-write frame is swapped out. */
+static uint16_t *swap_refs;
+
+/* Protects swap_bitmap and swap_refs. */
+static struct lock swap_lock;
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Number of pages written to and read from swap. */
+static long long swap_out_cnt;
+static long long swap_in_cnt;
+
+/* Sets up swap on the BLOCK_SWAP device, if there is one. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    printf ("no swap device--swap disabled\n");
+  else
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+  swap_bitmap = bitmap_create (slot_cnt);
+  swap_refs = malloc (sizeof *swap_refs * (slot_cnt + 1));
+  if (swap_bitmap == NULL || swap_refs == NULL)
+    PANIC ("couldn't create swap bitmap");
+}
+
+/* Writes the page at KPAGE to a free swap slot.  Returns the
+   slot's first sector, or -1 if swap is full. */
+block_sector_t
+swap_out (const void *kpage)
+{
+  block_sector_t sector;
+  size_t slot;
+  size_t i;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  if (slot != BITMAP_ERROR)
+    swap_refs[slot] = 1;
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return (block_sector_t) -1;
+
+  sector = slot * PAGE_SECTORS;
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, sector + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  swap_out_cnt++;
+  return sector;
+}
+
+/* Reads the swap slot that starts at SECTOR into KPAGE.  The
+   caller keeps its reference to the slot, to drop with
+   swap_free() once the page no longer needs it. */
+void
+swap_in (block_sector_t sector, void *kpage)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, sector + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  swap_in_cnt++;
+}
+
+/* Adds a reference to the swap slot that starts at SECTOR. */
+void
+swap_dup (block_sector_t sector)
+{
+  size_t slot = sector / PAGE_SECTORS;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot));
+  ASSERT (swap_refs[slot] < UINT16_MAX);
+  swap_refs[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to the swap slot that starts at SECTOR,
+   freeing it when the last one is gone. */
+void
+swap_free (block_sector_t sector)
+{
+  size_t slot = sector / PAGE_SECTORS;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot));
+  if (--swap_refs[slot] == 0)
+    bitmap_reset (swap_bitmap, slot);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld pages out, %lld pages in\n", swap_out_cnt, swap_in_cnt);
+}
@@ -0,0 +1,14 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+void swap_init (void);
+block_sector_t swap_out (const void *kpage);
+void swap_in (block_sector_t, void *kpage);
+void swap_dup (block_sector_t);
+void swap_free (block_sector_t);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */